@@ -23,6 +23,20 @@ BENCHMARKS="AveragingFilter_01_07_15"
 NUM_WORKERS="1 2 4 8"
 TRIALS=5
 
+# CHECK=1 checks the benchmarks for determinism instead of timing them: each option of
+# check_options_intel runs once with every worker count of CHECK_WORKERS, and the files it writes
+# and the output it prints (but the runtime) must match the run with the first count. Files must match bit for bit,
+# numbers printed may differ by the relative CHECK_TOLERANCE. CILKSAN=1 also builds the
+# benchmarks which have an llvm-pir.mk with the Cilksan race detector.
+CHECK="${CHECK:-0}"
+CHECK_WORKERS="${CHECK_WORKERS:-1 8}"
+CHECK_TOLERANCE="${CHECK_TOLERANCE:-0}"
+CILKSAN="${CILKSAN:-0}"
+CHECK_FAILURES=0
+# Lines printed by the checked runs which are timings or depend on the worker count (the busy
+# time of every worker and the imbalance of Mandelbrot options 4 and 5), dropped before comparing
+CHECK_IGNORE='^worker [0-9]+ busy |^imbalance |frames/s$| ticks'
+
 # COMPILE ERRORS:
 # MonteCarloSample_12_17_14 Rtm_Stencil_12_31_14 SepiaFilter_01_07_15
 # WRONG RUNTIME EXTRACTION:
@@ -57,17 +71,30 @@ function build_and_run_intel() {
 
     pushd $WORKSPACE > /dev/null
     build_intel "$1"
-    run_intel "$1" "$2" "$3"
+    if [[ $CHECK = 1 ]]; then
+        check_intel "$1"
+    else
+        run_intel "$1" "$2" "$3"
+    fi
     popd > /dev/null
 }
 
 function build_intel() {
     log_build="$LOGSPACE/$1-build.log"
+    make_flags="perf_num=1"
+
+    if [[ $CILKSAN = 1 ]]; then
+        if [[ -f llvm-pir.mk ]]; then
+            make_flags="$make_flags COMPILER=llvm-pir CILKSAN=1"
+        else
+            log "No llvm-pir.mk, building without Cilksan..."
+        fi
+    fi
 
     export CC=$CC_CURRENT
     export CXX=$CXX_CURRENT
     log "Building (log at $WORKSPACE/$log_build)..."
-    make run -B perf_num=1 >$log_build 2>&1
+    make run -B $make_flags >$log_build 2>&1
     unset CC
     unset CXX
 }
@@ -101,8 +128,110 @@ function run_intel() {
     done
 }
 
+# Prints the options given to "make run" by check_intel, one per line: the default one of the
+# Makefile (empty line), then every parallel version added to the benchmark
+function check_options_intel() {
+    echo ""
+    case $1 in
+        AveragingFilter_01_07_15)
+            for version in 5 6 7 8 9 10; do
+                echo "res/nahelam512.bmp check.bmp $version"
+            done
+            ;;
+        DCT_01_07_15)
+            for version in 5 6 7 8 9 10; do
+                echo "res/nahelam512.bmp check.bmp $version"
+            done
+            echo "-jpeg res/nahelam512.bmp check.jpg"
+            ;;
+        Mandelbrot_12_17_14)
+            for option in 4 5 6 7 8 9; do
+                echo "$option"
+            done
+            ;;
+    esac
+}
+
+# Compares two outputs line by line and word by word, allowing numbers to differ by the
+# relative tolerance $3
+function compare_output_intel() {
+    awk -v tolerance=$3 '
+        function is_number(s) { return s ~ /^[-+]?([0-9]+\.?[0-9]*|\.[0-9]+)([eE][-+]?[0-9]+)?$/ }
+        function abs(x) { return x < 0 ? -x : x }
+        BEGIN { while ((getline line < ARGV[1]) > 0) reference[++lines] = line; ARGV[1] = "" }
+        {
+            seen = FNR
+            n = split(reference[FNR], a)
+            if (FNR > lines || split($0, b) != n) { different = 1; exit }
+            for (i = 1; i <= n; i++) {
+                if (a[i] == b[i]) continue
+                if (!is_number(a[i]) || !is_number(b[i]) ||
+                    abs(a[i] - b[i]) > tolerance * abs(a[i])) { different = 1; exit }
+            }
+        }
+        END { exit different || seen != lines }
+    ' "$1" "$2"
+}
+
+function check_intel() {
+    mapfile -t options < <(check_options_intel "$1")
+
+    for index in "${!options[@]}"; do
+        option=${options[$index]}
+        make_option=()
+        if [[ -n $option ]]; then
+            make_option=("option=$option")
+        fi
+        reference=""
+
+        for num_workers in $CHECK_WORKERS; do
+            log_run="$LOGSPACE/$1-check-$index-$num_workers.log"
+            log_output="$LOGSPACE/$1-check-$index-$num_workers-output.log"
+            log_files="$LOGSPACE/$1-check-$index-$num_workers-files.log"
+            stamp="$LOGSPACE/$1-check.stamp"
+            run="option '${option:-default}' with $num_workers workers (log at $WORKSPACE/$log_run)"
+
+            export CILK_NWORKERS=$num_workers
+
+            # File times may only change once per clock tick, so leave one between the stamp and the run
+            touch $stamp
+            sleep 1
+            controlled_run $num_workers $log_run make run perf_num=1 "${make_option[@]}"
+            status=$?
+            head -n -1 $log_run | grep -v -E "$CHECK_IGNORE" >$log_output
+            find . -type f -newer $stamp -print0 | sort -z | xargs -0 -r cksum >$log_files
+            rm $stamp
+
+            unset CILK_NWORKERS
+
+            if [[ $status != 0 ]]; then
+                log "Running $run... FAILED"
+                CHECK_FAILURES=$(($CHECK_FAILURES+1))
+            elif [[ $CILKSAN = 1 ]] && grep -q "Race detected" $log_run; then
+                log "Running $run... RACES found by Cilksan"
+                CHECK_FAILURES=$(($CHECK_FAILURES+1))
+            elif [[ -z $reference ]]; then
+                reference=$num_workers
+                log "Running $run as the reference..."
+            elif cmp -s "$LOGSPACE/$1-check-$index-$reference-files.log" $log_files &&
+                    compare_output_intel "$LOGSPACE/$1-check-$index-$reference-output.log" $log_output $CHECK_TOLERANCE; then
+                log "Running $run... Same as $reference workers"
+            else
+                log "Running $run... DIFFERENT from $reference workers"
+                CHECK_FAILURES=$(($CHECK_FAILURES+1))
+            fi
+        done
+    done
+}
+
 rm $WORKSPACE/$LOGSPACE/*.log
 
 for benchmark in $BENCHMARKS; do
     build_and_run_intel $benchmark "$NUM_WORKERS" $TRIALS
 done
+
+if [[ $CHECK = 1 ]]; then
+    log_set_tag "check"
+    log "$CHECK_FAILURES runs failed or differ from their reference"
+    [[ $CHECK_FAILURES = 0 ]]
+fi
@@ -1,7 +1,8 @@
 CC ?= gcc
 CXX ?= g++
 
-CFLAGS := -O3 # -march=native
+# -mssse3 for the pshufb conversions of planar.cpp
+CFLAGS := -O3 -mssse3 # -march=native
 
 CFLAGS += $(OPTFLAGS) # -fcilkplus
 CXXFLAGS += $(OPTFLAGS) # -fcilkplus
@@ -15,6 +15,11 @@
 #include<stdlib.h>
 #include"timer.h"
 #include"AveragingFilter.h"
+#include"box_filter.h"
+#include"filter_graph.h"
+#include"planar.h"
+#include"bmp_io.h"
+#include"batch_pipeline.h"
 #include<cilk/cilk.h>
 
 #ifdef __INTEL_COMPILER
@@ -26,143 +31,233 @@
 #define ALIGN
 #endif
 #include<string.h>
-#include<xmmintrin.h>
+#include<emmintrin.h>
 #define ALIGNMENT 32 //Set to 16 bytes for SSE architectures and 32 bytes for Intel(R) AVX architectures
 using namespace std;
 
-ALIGN void process_image_serial(rgb *indataset __attribute__((assume_aligned(ALIGNMENT))), rgb *outdataset __attribute__((assume_aligned(ALIGNMENT))),
-				int w, int h){
-	int extra = 1;
-	int resized_width = w + 2;
-	int resized_height = h + 2;
-	int filter_row_size = 3;
-    ALIGN rgb *__restrict resized_indataset, *__restrict resized_outdataset;
-	resized_indataset = (rgb *)_mm_malloc((sizeof(rgb)*resized_width*resized_height), ALIGNMENT);
-	memset(resized_indataset, 0, (sizeof(rgb)*resized_width*resized_height));
-	resized_outdataset = (rgb *)_mm_malloc((sizeof(rgb)*resized_width*resized_height), ALIGNMENT);
-	memset(resized_outdataset, 0, (sizeof(rgb)*resized_width*resized_height));
-	for(int i = 0; i < h; i++)
-		memcpy((&resized_indataset[((i+1)*resized_width)+1].blue), &indataset[i*w].blue, (w*sizeof(rgb)));
-	unsigned char *in = (unsigned char *)resized_indataset;
-	unsigned char *out = (unsigned char *)resized_outdataset;
-	for(int i = 1; i < (h+1); i++)
+// Description:
+// Average of the 3x3 window around pixel (x, y), for the pixels on the border of the image.
+// With BORDER_ZERO the pixels outside the image count as 0, with BORDER_CLAMP they are replaced
+// by the nearest pixel of the image. The sum is divided by 9 in both cases.
+//
+// [in]: indataset, w, h, x, y, border
+// [out]: outdataset[y*w + x]
+static inline void border_pixel(const rgb *indataset, rgb *outdataset, int w, int h, int x, int y, BorderPolicy border){
+	unsigned int red = 0, green = 0, blue = 0;
+	for(int k1 = (-1); k1 <= 1; k1++)
 	{
-		int x = ((resized_width * i) + 1);
-		for(int j = x; j < (x + w); j++)
+		int row = y + k1;
+		if(row < 0 || row >= h)
 		{
-			unsigned int red = 0, green = 0, blue = 0;
-			for(int k1 = (-1); k1 <= 1; k1++)
+			if(border == BORDER_ZERO)
+				continue;
+			row = (row < 0) ? 0 : h - 1;
+		}
+		for(int k2 = (-1); k2 <= 1; k2++)
+		{
+			int column = x + k2;
+			if(column < 0 || column >= w)
 			{
-				int pos = j + (k1 * resized_width);
-				for(int k2 = (-1); k2 <= 1; k2++)
-				{
-					red += resized_indataset[(pos + k2)].red;
-					green += resized_indataset[(pos + k2)].green;
-					blue += resized_indataset[(pos + k2)].blue;
-				}
+				if(border == BORDER_ZERO)
+					continue;
+				column = (column < 0) ? 0 : w - 1;
 			}
-			resized_outdataset[j].red = red/9;
-			resized_outdataset[j].green = green/9;
-			resized_outdataset[j].blue = blue/9;
+			const rgb &pixel = indataset[row*w + column];
+			red += pixel.red;
+			green += pixel.green;
+			blue += pixel.blue;
 		}
 	}
-	for(int i = 0; i < h; i++)
-			memcpy(&outdataset[i*w].blue, (&resized_outdataset[((i+1)*resized_width)+1].blue), (w*sizeof(rgb)));
+	outdataset[y*w + x].red = red/9;
+	outdataset[y*w + x].green = green/9;
+	outdataset[y*w + x].blue = blue/9;
+}
 
-	_mm_free(resized_outdataset);
-	_mm_free(resized_indataset);
+// Description:
+// Filters row y straight from indataset to outdataset, without a padded copy of the image.
+// The first and last pixels of the row, and every pixel of the first and last rows, go through
+// border_pixel; the other pixels read their 3x3 window without any test.
+//
+// [in]: indataset, w, h, y, border
+// [out]: row y of outdataset
+static inline void filter_row(const rgb *__restrict indataset, rgb *__restrict outdataset, int w, int h, int y, BorderPolicy border){
+	if(y == 0 || y == h - 1 || w < 3)
+	{
+		for(int x = 0; x < w; x++)
+			border_pixel(indataset, outdataset, w, h, x, y, border);
+		return;
+	}
+	border_pixel(indataset, outdataset, w, h, 0, y, border);
+	const rgb *above = &indataset[(y - 1)*w];
+	const rgb *row = &indataset[y*w];
+	const rgb *below = &indataset[(y + 1)*w];
+	rgb *out = &outdataset[y*w];
+	for(int x = 1; x < w - 1; x++)
+	{
+		unsigned int red = 0, green = 0, blue = 0;
+		for(int k2 = (-1); k2 <= 1; k2++)
+		{
+			red += above[x + k2].red + row[x + k2].red + below[x + k2].red;
+			green += above[x + k2].green + row[x + k2].green + below[x + k2].green;
+			blue += above[x + k2].blue + row[x + k2].blue + below[x + k2].blue;
+		}
+		out[x].red = red/9;
+		out[x].green = green/9;
+		out[x].blue = blue/9;
+	}
+	border_pixel(indataset, outdataset, w, h, w - 1, y, border);
+}
+
+ALIGN void process_image_serial(rgb *indataset __attribute__((assume_aligned(ALIGNMENT))), rgb *outdataset __attribute__((assume_aligned(ALIGNMENT))),
+				int w, int h, BorderPolicy border){
+	for(int i = 0; i < h; i++)
+		filter_row(indataset, outdataset, w, h, i, border);
     return;
 }
 
-__attribute__((noinline)) void process_image_AN(rgb *indataset, rgb *outdataset, int w, int h){
-  return process_image_serial(indataset, outdataset, w, h);
+__attribute__((noinline)) void process_image_AN(rgb *indataset, rgb *outdataset, int w, int h, BorderPolicy border){
+  return process_image_serial(indataset, outdataset, w, h, border);
 }
 
 
 __attribute__((noinline)) void process_image_cilk_for(rgb *indataset __attribute__((assume_aligned(ALIGNMENT))),
 						      rgb *outdataset __attribute__((assume_aligned(ALIGNMENT))),
-						      int w, int h){
-	int extra = 1;
-	int resized_width = w + 2;
-	int resized_height = h + 2;
-	int filter_row_size = 3;
-	rgb * filter_interim_sum_rgb __attribute__((aligned(ALIGNMENT)));
-	rgb * resized_indataset, * resized_outdataset __attribute__((aligned(ALIGNMENT))) ;
-	resized_indataset = (rgb *)_mm_malloc((sizeof(rgb)*resized_width*resized_height), ALIGNMENT);
-	memset(resized_indataset, 0, (sizeof(rgb)*resized_width*resized_height));
-	resized_outdataset = (rgb *)_mm_malloc((sizeof(rgb)*resized_width*resized_height), ALIGNMENT);
-	memset(resized_outdataset, 0, (sizeof(rgb)*resized_width*resized_height));
-	for(int i = 0; i < h; i++)
-		memcpy((&resized_indataset[((i+1)*resized_width)+1].blue), &indataset[i*w].blue, (w*sizeof(rgb)));
-	unsigned char *in = (unsigned char *)resized_indataset;
-	unsigned char *out = (unsigned char *)resized_outdataset;
-	cilk_for(int i = 1; i < (h+1); i++)
+						      int w, int h, BorderPolicy border){
+	cilk_for(int i = 0; i < h; i++)
+		filter_row(indataset, outdataset, w, h, i, border);
+    return;
+}
+
+
+__attribute__((noinline)) void process_image_AN_cilk_for(rgb *indataset, rgb *outdataset, int w, int h, BorderPolicy border){
+  return process_image_cilk_for(indataset, outdataset, w, h, border);
+}
+
+// Description:
+// 3x3 average of pixel (x, y) of one plane, for the pixels on the border, as border_pixel does for rgb
+//
+// [in]: plane, w, h, x, y, border
+// [out]: average
+static inline unsigned char plane_border_pixel(const unsigned char *plane, int w, int h, int x, int y, BorderPolicy border){
+	unsigned int sum = 0;
+	for(int k1 = (-1); k1 <= 1; k1++)
 	{
-		int x = ((resized_width * i) + 1);
-		for(int j = x; j < (x + w); j++)
+		int row = y + k1;
+		if(row < 0 || row >= h)
 		{
-			unsigned int red = 0, green = 0, blue = 0;
-			for(int k1 = (-1); k1 <= 1; k1++)
+			if(border == BORDER_ZERO)
+				continue;
+			row = (row < 0) ? 0 : h - 1;
+		}
+		for(int k2 = (-1); k2 <= 1; k2++)
+		{
+			int column = x + k2;
+			if(column < 0 || column >= w)
 			{
-				int pos = j + (k1 * resized_width);
-				for(int k2 = (-1); k2 <= 1; k2++)
-				{
-					red += resized_indataset[(pos + k2)].red;
-					green += resized_indataset[(pos + k2)].green;
-					blue += resized_indataset[(pos + k2)].blue;
-				}
+				if(border == BORDER_ZERO)
+					continue;
+				column = (column < 0) ? 0 : w - 1;
 			}
-			resized_outdataset[j].red = red/9;
-			resized_outdataset[j].green = green/9;
-			resized_outdataset[j].blue = blue/9;
+			sum += plane[row*w + column];
 		}
 	}
-	for(int i = 0; i < h; i++)
-			memcpy(&outdataset[i*w].blue, (&resized_outdataset[((i+1)*resized_width)+1].blue), (w*sizeof(rgb)));
+	return sum/9;
+}
 
-	_mm_free(resized_outdataset);
-	_mm_free(resized_indataset);
-    return;
+// Description:
+// Filters row y of one plane. The interior pixels are done 16 at a time: the 9 bytes of every window
+// are added in 16 bit lanes (at most 9*255 = 2295), and the division by 9 is a multiplication by
+// 7282/65536 (_mm_mulhi_epu16), which gives the exact quotient for any sum up to 2295.
+//
+// [in]: in, w, h, y, border
+// [out]: row y of out
+static void filter_plane_row(const unsigned char *__restrict in, unsigned char *__restrict out, int w, int h, int y, BorderPolicy border){
+	if(y == 0 || y == h - 1 || w < 3)
+	{
+		for(int x = 0; x < w; x++)
+			out[y*w + x] = plane_border_pixel(in, w, h, x, y, border);
+		return;
+	}
+	const unsigned char *rows[3] = { &in[(y - 1)*w], &in[y*w], &in[(y + 1)*w] };
+	unsigned char *out_row = &out[y*w];
+	out_row[0] = plane_border_pixel(in, w, h, 0, y, border);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ninth = _mm_set1_epi16(7282);
+	int x = 1;
+	for(; x + 16 <= w - 1; x += 16)
+	{
+		__m128i low = zero, high = zero;
+		for(int r = 0; r < 3; r++)
+		{
+			for(int k2 = (-1); k2 <= 1; k2++)
+			{
+				__m128i v = _mm_loadu_si128((const __m128i *)(rows[r] + x + k2));
+				low = _mm_add_epi16(low, _mm_unpacklo_epi8(v, zero));
+				high = _mm_add_epi16(high, _mm_unpackhi_epi8(v, zero));
+			}
+		}
+		low = _mm_mulhi_epu16(low, ninth);
+		high = _mm_mulhi_epu16(high, ninth);
+		_mm_storeu_si128((__m128i *)(out_row + x), _mm_packus_epi16(low, high));
+	}
+	for(; x < w - 1; x++)
+	{
+		unsigned int sum = 0;
+		for(int r = 0; r < 3; r++)
+			sum += rows[r][x - 1] + rows[r][x] + rows[r][x + 1];
+		out_row[x] = sum/9;
+	}
+	out_row[w - 1] = plane_border_pixel(in, w, h, w - 1, y, border);
 }
 
+// Description:
+// 3x3 filter of an image split in blue, green and red planes. Every row of every plane is
+// an independent iteration of the cilk_for.
+//
+// [in]: indataset, w, h, border
+// [out]: outdataset
+__attribute__((noinline)) void process_image_SOA_cilk_for(const SOA_rgb &indataset, const SOA_rgb &outdataset, int w, int h, BorderPolicy border){
+	unsigned char *in[3] = { indataset.blue, indataset.green, indataset.red };
+	unsigned char *out[3] = { outdataset.blue, outdataset.green, outdataset.red };
+	cilk_for(int i = 0; i < 3*h; i++)
+		filter_plane_row(in[i/h], out[i/h], w, h, i%h, border);
+}
+
+// Allocates three planes of size pixels
+static bool allocate_planes(SOA_rgb &planes, int size){
+	planes.blue = (unsigned char *)_mm_malloc(size, ALIGNMENT);
+	planes.green = (unsigned char *)_mm_malloc(size, ALIGNMENT);
+	planes.red = (unsigned char *)_mm_malloc(size, ALIGNMENT);
+	return planes.blue != NULL && planes.green != NULL && planes.red != NULL;
+}
 
-__attribute__((noinline)) void process_image_AN_cilk_for(rgb *indataset, rgb *outdataset, int w, int h){
-  return process_image_cilk_for(indataset, outdataset, w, h);
+static void free_planes(SOA_rgb &planes){
+	_mm_free(planes.blue);
+	_mm_free(planes.green);
+	_mm_free(planes.red);
 }
 
 //This API does the reading and writing from/to the .bmp file. Also invokes the image processing API from here
-ALIGN int read_process_write(char* input, char *output, int choice) {
+ALIGN int read_process_write(char* input, char *output, int choice, int radius, BorderPolicy border) {
 
-    FILE *fp,*out;
-    bitmap_header* hp;
-    int n;
+    bmpio::MappedBMP in;
+    const bitmap_header* hp;
     CUtilTimer t;
     double avg_ticks = 0;
     // Making sure the AOS alignes to an address which is multiple of 16 to support vectorization 
     ALIGN rgb *indata, *outdata;
 
-    //Instantiating a file handle to open a input BMP file in binary mode
-    fp = fopen(input, "rb");
-    if(fp==NULL){
+    //Mapping the input BMP file into memory. The header and the pixels are read in place from the mapping
+    if(!in.open(input)){
         cout<<"The file could not be opened. Program will be exiting\n";
 	return 0;
     }
-
-
-    //Allocating memory for storing the bitmap header information which will be retrived from input image file
-    hp=(bitmap_header*)malloc(sizeof(bitmap_header));
-    if(hp==NULL)
-    {
-	cout<<"Unable to allocate the memory for bitmap header\n";
+    //The output is written while the input is still mapped, so they must be different files
+    if(bmpio::same_file(input, output)){
+        cout<<"The output file must not be the input file. Program will be exiting\n";
         return 0;
     }
-
-    //Reading from input file the bitmap header information which is inturn stored in memory allocated in the previous step
-    n=fread(hp, sizeof(bitmap_header), 1, fp);
-        if(n<1){
-            cout<<"Read error from the file. No bytes were read from the file. Program exiting \n";
-            return 0;        
-        }
+    hp=(const bitmap_header*)in.header();
 
     if(hp->bitsperpixel != 24){
         cout<<"This is not a RGB image\n";
@@ -177,15 +272,8 @@ ALIGN int read_process_write(char* input, char *output, int choice) {
         return 0;
     }
 
-    // Setting the File descriptor to the starting point in the input file where the bitmap data(payload) starts
-    fseek(fp,sizeof(char)*hp->fileheader.dataoffset,SEEK_SET);
-
-    // Reading the bitmap data from the input bmp file to the memory allocated in the previous step
-    n=fread(indata, sizeof(rgb), (hp->width * hp->height), fp);
-    if(n<1){
-        cout<<"Read error from the file. No bytes were read from the file. Program exiting \n";
-        return 0;
-    }
+    // Copying the bitmap data from the mapping to the aligned buffer, without the padding at the end of the rows
+    in.copy_pixels((unsigned char *)indata);
 	int size_of_image = hp->width * hp->height;
 
 	//Allocate memory for storing the bitmap data of the processed image
@@ -193,25 +281,70 @@ ALIGN int read_process_write(char* input, char *output, int choice) {
     if(outdata==NULL){
         cout<<"Unable to allocate the memory for bitmap date\n";
         return 0;
-    }    // Involing the image processing API which does some manipulation on the bitmap data read from the input .bmp file
+    }
+    //Versions 7 and 8 work on planes: the input is split into in_planes and the result packed from out_planes
+    SOA_rgb in_planes = {0, 0, 0}, out_planes = {0, 0, 0};
+    if(choice == 7 || choice == 8){
+        if(!allocate_planes(in_planes, size_of_image) || !allocate_planes(out_planes, size_of_image)){
+            cout<<"Unable to allocate the memory for the image planes\n";
+            return 0;
+        }
+    }
+    //Versions 9 and 10 chain the sepia tone and the box filter of the given radius, fused or one after the other
+    FilterGraph graph;
+    graph.add_transform(ColorTransform::sepia());
+    graph.add_box(radius);
+    // Involing the image processing API which does some manipulation on the bitmap data read from the input .bmp file
 
 for(int i = 0; i < 200; i++)
 {
 	switch(choice){
 	case 1:	t.start();
-			process_image_serial(indata, outdata, hp->width, hp->height);
+			process_image_serial(indata, outdata, hp->width, hp->height, border);
 			t.stop();
 			break;
 	case 2: t.start();
-			process_image_AN(indata, outdata, hp->width, hp->height);
+			process_image_AN(indata, outdata, hp->width, hp->height, border);
 			t.stop();
 			break;
 	case 3: t.start();
-			process_image_cilk_for(indata, outdata, hp->width, hp->height);
+			process_image_cilk_for(indata, outdata, hp->width, hp->height, border);
 			t.stop();
 			break;
 	case 4: t.start();
-			process_image_AN_cilk_for(indata, outdata, hp->width, hp->height);
+			process_image_AN_cilk_for(indata, outdata, hp->width, hp->height, border);
+			t.stop();
+			break;
+	case 5: t.start();
+			process_image_box_serial(indata, outdata, hp->width, hp->height, radius);
+			t.stop();
+			break;
+	case 6: t.start();
+			process_image_box_cilk_for(indata, outdata, hp->width, hp->height, radius);
+			t.stop();
+			break;
+	// Planar version, timed with the conversions from and to packed pixels
+	case 7: t.start();
+			planar::deinterleave_cilk_for((unsigned char *)indata, in_planes.blue, in_planes.green, in_planes.red, size_of_image);
+			process_image_SOA_cilk_for(in_planes, out_planes, hp->width, hp->height, border);
+			planar::interleave_cilk_for(out_planes.blue, out_planes.green, out_planes.red, (unsigned char *)outdata, size_of_image);
+			t.stop();
+			break;
+	// Planar version, timing the filter only
+	case 8: planar::deinterleave_cilk_for((unsigned char *)indata, in_planes.blue, in_planes.green, in_planes.red, size_of_image);
+			t.start();
+			process_image_SOA_cilk_for(in_planes, out_planes, hp->width, hp->height, border);
+			t.stop();
+			planar::interleave_cilk_for(out_planes.blue, out_planes.green, out_planes.red, (unsigned char *)outdata, size_of_image);
+			break;
+	// Sepia tone then box filter, one strip of rows at a time
+	case 9: t.start();
+			graph.run_fused(indata, outdata, hp->width, hp->height);
+			t.stop();
+			break;
+	// Sepia tone then box filter, each on the whole image
+	case 10: t.start();
+			graph.run_unfused(indata, outdata, hp->width, hp->height);
 			t.stop();
 			break;
 	default: cout<<"Wrong choice\n";
@@ -219,50 +352,67 @@ for(int i = 0; i < 200; i++)
 	}
 	avg_ticks += t.get_time();
 }
-    // Opening an output file to which the processed result will be written
-    out = fopen(output, "wb");
-    if(out==NULL){
-        cout<<"The file could not be opened. Program will be exiting\n";
-        return 0;
-    }
-
-    // Writing the bitmap header which we copied from the input file to the output file. We need not make any changes because we haven't made any change to the image size or compression type.
-    n=fwrite(hp,sizeof(char),sizeof(bitmap_header),out);
-    if(n<1){
-        cout<<"Write error to the file. No bytes were wrtten to the file. Program exiting \n";
-        return 0;
-    }
-
-    //Setting the file descriptor to point to the location where the bitmap data is to be written 
-    fseek(out,sizeof(char)*hp->fileheader.dataoffset,SEEK_SET);
-
-    // Writing the bitmap data of the processed image to the output file
-    n=fwrite(outdata,sizeof(rgb),(size_of_image),out);
-    if(n<1){
+    // Writing the header copied from the input file and the bitmap data of the processed image to the output file.
+    // We need not make any changes to the header because we haven't made any change to the image size or compression type.
+    if(!bmpio::write_bmp(output, in.header(), in.data_offset(), (unsigned char *)outdata, hp->width, hp->height, 24)){
         cout<<"Write error to the file. No bytes were wrtten to the file. Program exiting \n";
         return 0;
     }
 
     //cout<<"The time taken in number of ticks is "<<(endtime - starttime)<<"\n";
 	cout <<avg_ticks<<"\n";
-    // Closing all file handles and also freeing all the dynamically allocated memory
-    fclose(fp);
-    fclose(out);
-    free(hp);
+    // Unmapping the input file and also freeing all the dynamically allocated memory
+    in.close();
     _mm_free(indata);
     _mm_free(outdata);
+    free_planes(in_planes);
+    free_planes(out_planes);
     return 0;
 }
+//Filter used by the batch mode, the same as choice 3
+void batch_filter(unsigned char *in, unsigned char *out, int w, int h){
+	process_image_cilk_for((rgb *)in, (rgb *)out, w, h, BORDER_ZERO);
+}
+
 int main(int argc, char *argv[]){
+        if(argc > 1 && strcmp(argv[1], "-batch") == 0)
+                return batch::batch_main(argc, argv, batch_filter);
         if(argc < 3){
-                cout<<"Program usage is <modified_program> <inputfile.bmp> <outputfile.bmp>\n";
+                cout<<"Program usage is <modified_program> <inputfile.bmp> <outputfile.bmp> [version] [radius] [zero|clamp]\n";
+                cout<<"              or <modified_program> -batch <outputdir> <inputfile.bmp | inputdir> ...\n";
                 return 0;
         }
     int choice = 3;
 		//cout<<"Please enter the version you want to execute:\n";
 		//cout<<"1) Serial version\n";
-        read_process_write(argv[1], argv[2], choice);
+		//cout<<"5) Separable box filter of any radius\n";
+		//cout<<"6) Separable box filter of any radius + cilk_for version\n";
+		//cout<<"7) Planar (SOA) SIMD + cilk_for version, with the conversions\n";
+		//cout<<"8) Planar (SOA) SIMD + cilk_for version, without the conversions\n";
+		//cout<<"9) Sepia tone and box filter fused, strip by strip + cilk_for version\n";
+		//cout<<"10) Sepia tone and box filter, one after the other + cilk_for version\n";
+    if(argc > 3)
+        choice = atoi(argv[3]);
+    // Radius of the box filter of versions 5, 6, 9 and 10, 1 for the same 3x3 filter as the other versions
+    int radius = 1;
+    if(argc > 4)
+        radius = atoi(argv[4]);
+    if(radius < 0 || radius > BOX_MAX_RADIUS){
+        cout<<"The radius must be between 0 and "<<BOX_MAX_RADIUS<<"\n";
         return 0;
+    }
+    // Border handling of versions 1 to 4, 7 and 8: the pixels outside the image are 0, or copies of the nearest edge pixel
+    BorderPolicy border = BORDER_ZERO;
+    if(argc > 5){
+        if(strcmp(argv[5], "clamp") == 0)
+            border = BORDER_CLAMP;
+        else if(strcmp(argv[5], "zero") != 0){
+            cout<<"The border must be zero or clamp\n";
+            return 0;
+        }
+    }
+    read_process_write(argv[1], argv[2], choice, radius, border);
+    return 0;
 }
 
 
@@ -10,6 +10,9 @@
 // PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
 //
 // ======================================================================================
+#ifndef AVERAGINGFILTER_H
+#define AVERAGINGFILTER_H
+
 // This is the data structure for Windows 3.x Bitmap File header 
 #pragma pack(push,1)
 typedef struct {
@@ -49,4 +52,13 @@ typedef struct {
 	unsigned char *green;
 	unsigned char *red;
 } SOA_rgb;
-#pragma pack(pop)
\ No newline at end of file
+#pragma pack(pop)
+
+//Border handling of the 3x3 filter: the pixels outside the image are taken as 0 (BORDER_ZERO),
+//or as the nearest pixel of the image (BORDER_CLAMP)
+enum BorderPolicy {
+	BORDER_ZERO,
+	BORDER_CLAMP
+};
+
+#endif // AVERAGINGFILTER_H
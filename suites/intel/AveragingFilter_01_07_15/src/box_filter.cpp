@@ -0,0 +1,135 @@
+//=======================================================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ======================================================================================
+#include<string.h>
+#include<xmmintrin.h>
+#include<cilk/cilk.h>
+#include"box_filter.h"
+#include"worker_arena.h"
+
+#define ALIGNMENT 32
+
+// Description:
+// Running sum along one row: sums[3*x + c] is the sum of channel c over the pixels x-radius to x+radius
+//
+// [in]: row, w, radius
+// [out]: sums (3*w values)
+static void horizontal_sums(const rgb *row, unsigned int *sums, int w, int radius){
+	unsigned int red = 0, green = 0, blue = 0;
+	for(int i = 0; i <= radius && i < w; i++)
+	{
+		blue += row[i].blue;
+		green += row[i].green;
+		red += row[i].red;
+	}
+	for(int x = 0; x < w; x++)
+	{
+		sums[3*x] = blue;
+		sums[3*x + 1] = green;
+		sums[3*x + 2] = red;
+		if(x + radius + 1 < w)
+		{
+			blue += row[x + radius + 1].blue;
+			green += row[x + radius + 1].green;
+			red += row[x + radius + 1].red;
+		}
+		if(x - radius >= 0)
+		{
+			blue -= row[x - radius].blue;
+			green -= row[x - radius].green;
+			red -= row[x - radius].red;
+		}
+	}
+}
+
+// Description:
+// Filters the rows first_row to last_row-1. The horizontal sums of the 2r+1 rows in the window are
+// kept in a ring, and their column sums in vertical; moving down one row subtracts the row which
+// leaves the window and adds the one which enters it.
+// The first row of indataset is row in_first of the image, the first of outdataset row out_first.
+//
+// [in]: indataset, in_first, out_first, w, h, radius, first_row, last_row, ring ((2r+1)*3*w values), vertical (3*w values)
+// [out]: outdataset
+static void box_strip(const rgb *indataset, int in_first, rgb *outdataset, int out_first, int w, int h, int radius,
+					  int first_row, int last_row, unsigned int *ring, unsigned int *vertical){
+	const int window = 2*radius + 1;
+	const int n = 3*w;
+	const unsigned long long reciprocal = box_reciprocal(window * window);
+	unsigned char *out = (unsigned char *)outdataset;
+
+	memset(vertical, 0, n*sizeof(unsigned int));
+	for(int j = (first_row - radius > 0 ? first_row - radius : 0); j <= first_row + radius && j < h; j++)
+	{
+		unsigned int *sums = ring + (j % window)*n;
+		horizontal_sums(&indataset[(j - in_first)*w], sums, w, radius);
+		for(int i = 0; i < n; i++)
+			vertical[i] += sums[i];
+	}
+	for(int y = first_row; y < last_row; y++)
+	{
+		unsigned char *out_row = out + (y - out_first)*n;
+		for(int i = 0; i < n; i++)
+			out_row[i] = (unsigned char)((vertical[i] * reciprocal) >> BOX_RECIPROCAL_SHIFT);
+		if(y + 1 == last_row)
+			break;
+		if(y - radius >= 0)
+		{
+			unsigned int *sums = ring + ((y - radius) % window)*n;
+			for(int i = 0; i < n; i++)
+				vertical[i] -= sums[i];
+		}
+		if(y + radius + 1 < h)
+		{
+			// Same slot as the row which just left the window
+			unsigned int *sums = ring + ((y + radius + 1) % window)*n;
+			horizontal_sums(&indataset[(y + radius + 1 - in_first)*w], sums, w, radius);
+			for(int i = 0; i < n; i++)
+				vertical[i] += sums[i];
+		}
+	}
+}
+
+// Scratch of one strip, the ring of row sums followed by the column sums, taken from the arena
+// of the calling worker: after the first call, filtering does not allocate any memory
+static unsigned int *strip_scratch(WorkerArena &arena, int w, int radius){
+	return (unsigned int *)arena.get(box_rows_scratch_size(w, radius), ALIGNMENT);
+}
+
+size_t box_rows_scratch_size(int w, int radius){
+	return (2*radius + 2)*3*w*sizeof(unsigned int);
+}
+
+void process_rows_box(const rgb *indataset, int in_first, rgb *outdataset, int out_first, int w, int h, int radius,
+					  int first_row, int last_row, void *scratch){
+	unsigned int *ring = (unsigned int *)scratch;
+	box_strip(indataset, in_first, outdataset, out_first, w, h, radius, first_row, last_row, ring, ring + (2*radius + 1)*3*w);
+}
+
+void process_image_box_serial(const rgb *indataset, rgb *outdataset, int w, int h, int radius){
+	static WorkerArena arena;
+	unsigned int *ring = strip_scratch(arena, w, radius);
+	box_strip(indataset, 0, outdataset, 0, w, h, radius, 0, h, ring, ring + (2*radius + 1)*3*w);
+}
+
+void process_image_box_cilk_for(const rgb *indataset, rgb *outdataset, int w, int h, int radius){
+	const int window = 2*radius + 1;
+	const int strip_rows = (2*window > BOX_STRIP_ROWS) ? 2*window : BOX_STRIP_ROWS;
+	const int strips = (h + strip_rows - 1)/strip_rows;
+	static WorkerArena arena;
+	cilk_for(int s = 0; s < strips; s++)
+	{
+		int first_row = s*strip_rows;
+		int last_row = (first_row + strip_rows < h) ? first_row + strip_rows : h;
+		unsigned int *ring = strip_scratch(arena, w, radius);
+		box_strip(indataset, 0, outdataset, 0, w, h, radius, first_row, last_row, ring, ring + window*3*w);
+	}
+}
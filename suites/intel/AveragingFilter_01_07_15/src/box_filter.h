@@ -0,0 +1,69 @@
+//=======================================================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ======================================================================================
+// Separable box filter of any radius: the average of the (2r+1)x(2r+1) window around every
+// pixel, with the pixels outside the image taken as 0, as in process_image_serial.
+// The window sum is a running sum along the row followed by a running sum down the columns,
+// so every pixel costs the same whatever the radius. The division by the window size is a
+// multiplication by a fixed-point reciprocal, exact for every possible window sum.
+#ifndef BOX_FILTER_H
+#define BOX_FILTER_H
+
+#include <stddef.h>
+#include "AveragingFilter.h"
+
+// Largest radius for which the reciprocal of the window size stays exact
+const int BOX_MAX_RADIUS = 127;
+
+// Fraction bits of the reciprocal
+const int BOX_RECIPROCAL_SHIFT = 40;
+
+// Rows filtered by one iteration of the parallel loop, at least. A strip starts by summing the
+// 2r+1 rows around its first row, so strips are made at least twice as high as the window
+const int BOX_STRIP_ROWS = 64;
+
+// Reciprocal of divisor such that (n * reciprocal) >> BOX_RECIPROCAL_SHIFT == n / divisor
+// for every n <= 255 * divisor, when divisor <= (2*BOX_MAX_RADIUS+1)^2
+inline unsigned long long box_reciprocal(unsigned int divisor) {
+	return ((1ULL << BOX_RECIPROCAL_SHIFT) + divisor - 1) / divisor;
+}
+
+// Description:
+// Box filter of the given radius, one strip of rows after the other.
+// radius 1 gives the same image as process_image_serial.
+//
+// [in]: indataset, w, h, radius (0 to BOX_MAX_RADIUS)
+// [out]: outdataset
+void process_image_box_serial(const rgb *indataset, rgb *outdataset, int w, int h, int radius);
+
+// Description:
+// Same as process_image_box_serial, with the strips filtered in parallel with cilk_for.
+//
+// [in]: indataset, w, h, radius (0 to BOX_MAX_RADIUS)
+// [out]: outdataset
+void process_image_box_cilk_for(const rgb *indataset, rgb *outdataset, int w, int h, int radius);
+
+// Description:
+// Box filter of the rows first_row to last_row-1 of a w x h image of which only some rows are in memory,
+// for filters which run on strips of rows. indataset starts at row in_first of the image and holds every
+// row of the image within radius of first_row..last_row-1; the rows are written to outdataset, which
+// starts at row out_first. The pixels outside the image are 0, as in process_image_box_serial.
+//
+// [in]: indataset, in_first, out_first, w, h, radius, first_row, last_row, scratch (box_rows_scratch_size bytes)
+// [out]: outdataset
+void process_rows_box(const rgb *indataset, int in_first, rgb *outdataset, int out_first, int w, int h, int radius,
+					  int first_row, int last_row, void *scratch);
+
+// Bytes of scratch needed by process_rows_box
+size_t box_rows_scratch_size(int w, int radius);
+
+#endif // BOX_FILTER_H
@@ -0,0 +1,131 @@
+//=======================================================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ======================================================================================
+#include<string.h>
+#include<cilk/cilk.h>
+#include"filter_graph.h"
+
+#define ALIGNMENT 32
+
+void FilterGraph::add_transform(const ColorTransform &transform){
+	Stage stage;
+	stage.radius = -1;
+	stage.transform = transform;
+	m_stages.push_back(stage);
+}
+
+bool FilterGraph::add_box(int radius){
+	if(radius < 0 || radius > BOX_MAX_RADIUS)
+		return false;
+	Stage stage;
+	stage.radius = radius;
+	m_stages.push_back(stage);
+	return true;
+}
+
+void FilterGraph::run_fused(const rgb *indataset, rgb *outdataset, int w, int h){
+	const int stages = (int)m_stages.size();
+	if(stages == 0)
+	{
+		memcpy(outdataset, indataset, sizeof(rgb)*w*h);
+		return;
+	}
+	// halo[k]: rows needed above and below a strip from the output of stage k, the sum of the
+	// radii of the box filters after it; total: rows needed from the input image
+	std::vector<int> halo(stages);
+	int total = 0, max_radius = 0;
+	for(int k = stages - 1; k >= 0; k--)
+	{
+		halo[k] = total;
+		if(m_stages[k].radius > 0)
+		{
+			total += m_stages[k].radius;
+			if(m_stages[k].radius > max_radius)
+				max_radius = m_stages[k].radius;
+		}
+	}
+	int strip_rows = FUSED_STRIP_BYTES/(3*w);
+	if(strip_rows < FUSED_MIN_STRIP_WINDOWS*(2*total + 1))
+		strip_rows = FUSED_MIN_STRIP_WINDOWS*(2*total + 1);
+	const int strips = (h + strip_rows - 1)/strip_rows;
+	// Every worker takes from the arena two strips with their halo, used in turn as input and output
+	// of the filters, followed by the scratch of the box filters
+	const size_t buffer_bytes = ((size_t)(strip_rows + 2*total)*3*w + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+	const size_t scratch_bytes = 2*buffer_bytes + box_rows_scratch_size(w, max_radius);
+
+	cilk_for(int s = 0; s < strips; s++)
+	{
+		int first_row = s*strip_rows;
+		int last_row = (first_row + strip_rows < h) ? first_row + strip_rows : h;
+		unsigned char *scratch = (unsigned char *)m_arena.get(scratch_bytes, ALIGNMENT);
+		rgb *buffers[2] = { (rgb *)scratch, (rgb *)(scratch + buffer_bytes) };
+		void *box_scratch = scratch + 2*buffer_bytes;
+
+		// current holds the rows from in_first of the output of the previous stage, at first the input image
+		int in_first = (first_row - total > 0) ? first_row - total : 0;
+		const rgb *current = indataset + in_first*w;
+		int current_buffer = -1;
+		for(int k = 0; k < stages; k++)
+		{
+			const Stage &stage = m_stages[k];
+			int out_first = (first_row - halo[k] > 0) ? first_row - halo[k] : 0;
+			int out_last = (last_row + halo[k] < h) ? last_row + halo[k] : h;
+			// The last stage writes to the output image, a transform works in place once the rows are in
+			// a buffer, and a box filter writes to the buffer it does not read
+			rgb *target;
+			if(k == stages - 1)
+				target = outdataset + out_first*w;
+			else if(stage.radius < 0 && current_buffer >= 0)
+				target = buffers[current_buffer];
+			else
+			{
+				current_buffer = (current_buffer == 0) ? 1 : 0;
+				target = buffers[current_buffer];
+			}
+			if(stage.radius < 0)
+				stage.transform.apply((const unsigned char *)current, (unsigned char *)target, (out_last - out_first)*w);
+			else
+				process_rows_box(current, in_first, target, out_first, w, h, stage.radius, out_first, out_last, box_scratch);
+			current = target;
+			in_first = out_first;
+		}
+	}
+}
+
+void FilterGraph::run_unfused(const rgb *indataset, rgb *outdataset, int w, int h){
+	const int stages = (int)m_stages.size();
+	if(stages == 0)
+	{
+		memcpy(outdataset, indataset, sizeof(rgb)*w*h);
+		return;
+	}
+	m_temporary.resize((size_t)w*h);
+	// Output image of every stage, chosen from the last one backwards: the last stage writes to
+	// outdataset, a transform to the image it reads, and a box filter reads the other image
+	std::vector<rgb *> targets(stages);
+	rgb *target = outdataset;
+	for(int k = stages - 1; k >= 0; k--)
+	{
+		targets[k] = target;
+		if(m_stages[k].radius >= 0)
+			target = (target == outdataset) ? &m_temporary[0] : outdataset;
+	}
+	const rgb *current = indataset;
+	for(int k = 0; k < stages; k++)
+	{
+		if(m_stages[k].radius < 0)
+			m_stages[k].transform.apply_cilk_for((const unsigned char *)current, (unsigned char *)targets[k], w*h);
+		else
+			process_image_box_cilk_for(current, targets[k], w, h, m_stages[k].radius);
+		current = targets[k];
+	}
+}
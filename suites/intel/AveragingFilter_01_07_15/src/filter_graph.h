@@ -0,0 +1,73 @@
+//=======================================================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ======================================================================================
+// Chain of filters run one after the other on an image: color transforms, which change every
+// pixel on its own (sepia, color matrix, tables), and box filters, which average a window.
+// run_fused does every filter on a strip of rows before going to the next strip, so the image
+// is read once and written once and the intermediate strips stay in the cache. A box filter of
+// radius r needs r more rows above and below from the filter before it, so the first filters
+// of a strip also work on the rows around it, which the neighbouring strips compute again.
+// run_unfused does every filter on the whole image before the next one, for comparison; both
+// give the same image.
+#ifndef FILTER_GRAPH_H
+#define FILTER_GRAPH_H
+
+#include<vector>
+#include"box_filter.h"
+#include"color_transform.h"
+#include"worker_arena.h"
+
+// Bytes of one strip of rows, small enough for two strips and the sums of a box filter to stay in L2
+const int FUSED_STRIP_BYTES = 256 * 1024;
+
+// Strips are at least this many times as high as the rows needed around them, so that the rows
+// computed again by the neighbouring strips stay a small part of the work
+const int FUSED_MIN_STRIP_WINDOWS = 4;
+
+class FilterGraph {
+public:
+	// Must be created outside of any parallel region, like the WorkerArena it holds
+	FilterGraph() {}
+
+	void add_transform(const ColorTransform &transform);
+	// Returns false if radius is not within 0..BOX_MAX_RADIUS
+	bool add_box(int radius);
+
+	// Description:
+	// Runs the filters one strip of rows at a time, the strips in parallel with cilk_for.
+	//
+	// [in]: indataset, w, h
+	// [out]: outdataset
+	void run_fused(const rgb *indataset, rgb *outdataset, int w, int h);
+
+	// Description:
+	// Runs every filter on the whole image, each one in parallel, through a temporary image.
+	//
+	// [in]: indataset, w, h
+	// [out]: outdataset
+	void run_unfused(const rgb *indataset, rgb *outdataset, int w, int h);
+
+private:
+	FilterGraph(const FilterGraph &);
+	FilterGraph &operator=(const FilterGraph &);
+
+	// A box filter of the given radius, or the transform when radius is -1
+	struct Stage {
+		int radius;
+		ColorTransform transform;
+	};
+	std::vector<Stage> m_stages;
+	WorkerArena m_arena;
+	std::vector<rgb> m_temporary;
+};
+
+#endif // FILTER_GRAPH_H
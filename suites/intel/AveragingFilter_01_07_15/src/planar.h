@@ -0,0 +1,56 @@
+//==============================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ===============================================================
+
+// Conversions between packed 24 bit pixels (blue, green, red, blue, ...: the rgb struct of the
+// samples, an array of structures) and three separate planes of blue, green and red bytes
+// (the SOA_rgb struct, a structure of arrays), on which the filters can work on 16 pixels at once.
+// With SSSE3 (-mssse3 or any later target, as in gcc.mk; /arch:AVX with MSVC) 16 pixels are
+// converted with 9 pshufb, otherwise one pixel at a time. "make check_planar" compares the output
+// of the planar versions with the packed ones.
+// The same files are copied in every sample which has planar kernels, like bmp_io.h.
+
+#ifndef PLANAR_H
+#define PLANAR_H
+
+#include <stddef.h>
+
+namespace planar {
+
+// Pixels converted by one iteration of the parallel conversion loops
+const size_t CONVERSION_CHUNK = 16384;
+
+// Description:
+// Splits pixels packed pixels into three planes.
+//
+// [in]: packed (3 * pixels bytes), pixels
+// [out]: blue, green, red (pixels bytes each)
+void deinterleave(const unsigned char* packed, unsigned char* blue, unsigned char* green,
+				  unsigned char* red, size_t pixels);
+
+// Description:
+// Packs three planes of pixels bytes into 24 bit pixels.
+//
+// [in]: blue, green, red, pixels
+// [out]: packed (3 * pixels bytes)
+void interleave(const unsigned char* blue, const unsigned char* green, const unsigned char* red,
+				unsigned char* packed, size_t pixels);
+
+// Same as deinterleave and interleave, one CONVERSION_CHUNK at a time with cilk_for
+void deinterleave_cilk_for(const unsigned char* packed, unsigned char* blue, unsigned char* green,
+						   unsigned char* red, size_t pixels);
+void interleave_cilk_for(const unsigned char* blue, const unsigned char* green, const unsigned char* red,
+						 unsigned char* packed, size_t pixels);
+
+} // namespace planar
+
+#endif // PLANAR_H
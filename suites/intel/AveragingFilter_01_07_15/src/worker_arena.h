@@ -0,0 +1,57 @@
+//=======================================================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ======================================================================================
+// Scratch memory reused across calls: one aligned block per Intel(R) Cilk(TM) Plus worker,
+// which only grows when a caller asks for more than the block holds.
+// A block belongs to the worker which asks for it, and stays valid until that worker asks again,
+// so it must not be held across a cilk_spawn or a cilk_sync.
+#ifndef WORKER_ARENA_H
+#define WORKER_ARENA_H
+
+#include<vector>
+#include<xmmintrin.h>
+#include<cilk/cilk_api.h>
+
+class WorkerArena {
+public:
+	// Must be created outside of any parallel region, as it sizes itself to the number of workers
+	WorkerArena() : m_blocks(__cilkrts_get_nworkers()) {}
+	~WorkerArena() {
+		for(size_t i = 0; i < m_blocks.size(); i++)
+			_mm_free(m_blocks[i].data);
+	}
+	// Scratch of at least size bytes, aligned to alignment, for the calling worker
+	void *get(size_t size, size_t alignment) {
+		Block &block = m_blocks[__cilkrts_get_worker_number()];
+		if(block.size < size)
+		{
+			_mm_free(block.data);
+			block.data = _mm_malloc(size, alignment);
+			block.size = size;
+		}
+		return block.data;
+	}
+private:
+	WorkerArena(const WorkerArena &);
+	WorkerArena &operator=(const WorkerArena &);
+
+	// Blocks are padded to a cache line so that two workers never write to the same line
+	struct Block {
+		Block() : data(0), size(0) {}
+		void *data;
+		size_t size;
+		char padding[64 - sizeof(void *) - sizeof(size_t)];
+	};
+	std::vector<Block> m_blocks;
+};
+
+#endif // WORKER_ARENA_H
@@ -19,6 +19,7 @@
 #include <algorithm>
 #include <atomic>
 #include "binomial_lattice.h"
+#include "worker_arena.h"
 #include <mutex>
 #include <cilk/cilk.h>
 #include <cilk/reducer_opadd.h>
@@ -30,6 +31,49 @@
 // For an American option, since the option may either be held or exercised prior to expiry,
 // the value at each node is: Max (Binomial Value, Exercise Value).
 
+// Arrays of one option, taken from the scratch of the worker pricing it
+struct LatticeScratch {
+	fptype* opt_price;	// option values at the nodes of a time step
+	fptype* node_price;	// stock prices at the nodes, see fill_node_prices
+	int stride;			// distance between the arrays, in elements
+};
+
+// Description:
+// Returns the arrays for an option priced by the calling worker. They stay valid until the worker
+// prices its next option, so that the options reuse the same memory rather than allocating it.
+//
+// [in]: arena
+// [out]: none
+static LatticeScratch lattice_scratch(WorkerArena& arena) {
+	LatticeScratch scratch;
+	// Every array starts on a cache line
+	scratch.stride = (MAX_NTIMESTEPS + 15) & ~15;
+	scratch.opt_price = (fptype*)arena.get(3 * scratch.stride * sizeof(fptype), 64);
+	scratch.node_price = scratch.opt_price + scratch.stride;
+	return scratch;
+}
+
+// Description:
+// Computes the stock price at every node of the lattice. Since d = 1 / u, the price at node j of
+// time step i, after i - j moves up and j moves down, is s * u^(i - 2 * j): it only depends on
+// k = OPT_TIMESTEPS - i + 2 * j, from 0 to 2 * OPT_TIMESTEPS. The prices of even k are stored first,
+// then those of odd k, so that the nodes of a time step are contiguous (see node_row). They are
+// computed in closed form, without the rounding errors built up by repeated products of u and d.
+//
+// [in]: stock_price, log_u (the log of u, volatility * sqrt(deltat)), stride
+// [out]: node_price (stride + OPT_TIMESTEPS entries)
+static void fill_node_prices(fptype stock_price, fptype log_u, int stride, fptype* node_price) {
+	for (int k = 0; k <= 2 * OPT_TIMESTEPS; k++) {
+		node_price[(k & 1) * stride + (k >> 1)] = stock_price * exp(log_u * (OPT_TIMESTEPS - k));
+	}
+}
+
+// Stock prices at the nodes 0 to i of time step i
+static inline const fptype* node_row(const fptype* node_price, int stride, int i) {
+	int k = OPT_TIMESTEPS - i;
+	return node_price + (k & 1) * stride + (k >> 1);
+}
+
 // Description:
 // This function computes the price results for each node.
 //
@@ -41,12 +85,12 @@ fptype binomial_lattice_scalar(OptionData* optionValues, fptype* priceResult) {
 	const fptype ONE = fptype(1.);
 	const fptype ZERO = fptype(0.);
 	fptype total_priceResult = 0;
+	static WorkerArena arena;
 
 	for (int k = 0; k < NUM_OPTIONS; k++) {
-		fptype* opt_price = new fptype[MAX_NTIMESTEPS];
-		fptype* upow_tbl = new fptype[MAX_NTIMESTEPS];
-		fptype* dpow_tbl = new fptype[MAX_NTIMESTEPS];
-		fptype* tmp_val  = new fptype[MAX_NTIMESTEPS];
+		LatticeScratch scratch = lattice_scratch(arena);
+		fptype* opt_price  = scratch.opt_price;
+		fptype* node_price = scratch.node_price;
 
 		fptype risk_free_rate = optionValues[k].r;
 		fptype stock_price    = optionValues[k].s;
@@ -56,44 +100,34 @@ fptype binomial_lattice_scalar(OptionData* optionValues, fptype* priceResult) {
 
 		deltat /= OPT_TIMESTEPS;
 
-		fptype u = exp(volatility * sqrt(deltat));
-		fptype d = exp(-volatility * sqrt(deltat));
+		fptype log_u = volatility * sqrt(deltat);
+		fptype u = exp(log_u);
+		fptype d = exp(-log_u);
 		fptype a = exp(risk_free_rate * deltat);
 		fptype multiplier = exp(-risk_free_rate * deltat);
 
 		fptype p = (a - d) / (u - d);
 
-		upow_tbl[0] = stock_price;
-		dpow_tbl[0] = ONE;
-
-		for (int i = 1; i <= OPT_TIMESTEPS; i++) {
-			upow_tbl[i] = u * upow_tbl[i - 1];
-			dpow_tbl[i] = d * dpow_tbl[i - 1];
-		}
+		fill_node_prices(stock_price, log_u, scratch.stride, node_price);
 
 		// Initial values at expiration time
 		for (int i = 0; i <= OPT_TIMESTEPS; i++) {
-			opt_price[i] = std::max((exe_price - upow_tbl[OPT_TIMESTEPS - i] * dpow_tbl[i]), ZERO);
+			opt_price[i] = std::max((exe_price - node_price[i]), ZERO);
 		}
 
-		// Move to earlier times
+		// Move to earlier times, in place: node j of a time step only needs the nodes j and j + 1 of the
+		// time step after it, and it is computed before node j + 1 is overwritten.
 		for (int i = OPT_TIMESTEPS - 1; i >= 0; i--) {
+			const fptype* row = node_row(node_price, scratch.stride, i);
 			for (int j = 0; j <= i; j++) {
-				tmp_val[j] = (p * opt_price[j] + (ONE - p) * opt_price[j+1]) * multiplier;
-			}
-			// If exercise is permitted at the node, then the model takes the greater of binomial and exercise value at the node.
-			for (int j = 0; j <= i; j++) {
-				fptype t1 = upow_tbl[i - j] * dpow_tbl[j];
-				fptype early_exe_value = std::max(exe_price - t1, ZERO);
-				opt_price[j] = std::max(early_exe_value, tmp_val[j]);
+				fptype binomial_value = (p * opt_price[j] + (ONE - p) * opt_price[j+1]) * multiplier;
+				// If exercise is permitted at the node, then the model takes the greater of binomial and exercise value at the node.
+				fptype early_exe_value = std::max(exe_price - row[j], ZERO);
+				opt_price[j] = std::max(early_exe_value, binomial_value);
 			}
 		}
 		priceResult[k] = opt_price[0];
 		total_priceResult += priceResult[k];
-		delete[] opt_price;
-		delete[] upow_tbl;
-		delete[] dpow_tbl;
-		delete[] tmp_val;
 	}
 	return total_priceResult;
 }
@@ -110,12 +144,12 @@ fptype binomial_lattice_cilk(OptionData* optionValues, fptype* priceResult) {
 	const fptype ONE = fptype(1.);
 
 	cilk::reducer<cilk::op_add<fptype> > total_priceResult;
+	static WorkerArena arena;
 
 	cilk_for (int k = 0; k < NUM_OPTIONS; ++k) {
-		fptype* opt_price = new fptype[MAX_NTIMESTEPS];
-		fptype* upow_tbl  = new fptype[MAX_NTIMESTEPS];
-		fptype* dpow_tbl  = new fptype[MAX_NTIMESTEPS];
-		fptype* tmp_val   = new fptype[MAX_NTIMESTEPS];
+		LatticeScratch scratch = lattice_scratch(arena);
+		fptype* opt_price  = scratch.opt_price;
+		fptype* node_price = scratch.node_price;
 
 		fptype risk_free_rate = optionValues[k].r;
 		fptype stock_price    = optionValues[k].s;
@@ -125,43 +159,33 @@ fptype binomial_lattice_cilk(OptionData* optionValues, fptype* priceResult) {
 
 		deltat /= OPT_TIMESTEPS;
 
-		fptype u = exp(volatility * sqrt(deltat));
-		fptype d = exp(-volatility * sqrt(deltat));
+		fptype log_u = volatility * sqrt(deltat);
+		fptype u = exp(log_u);
+		fptype d = exp(-log_u);
 		fptype a = exp(risk_free_rate * deltat);
 		fptype multiplier = exp(-risk_free_rate * deltat);
 
 		fptype p = (a - d) / (u - d);
 
-		upow_tbl[0] = stock_price;
-		dpow_tbl[0] = ONE;
-
-		for (int i = 1; i <= OPT_TIMESTEPS; i++) {
-			upow_tbl[i] = u * upow_tbl[i - 1];
-			dpow_tbl[i] = d * dpow_tbl[i - 1];
-		}
+		fill_node_prices(stock_price, log_u, scratch.stride, node_price);
 
 		// Initial values at expiration time
 		for (int i = 0; i <= OPT_TIMESTEPS; i++) {
-			opt_price[i] = std::max((exe_price - upow_tbl[OPT_TIMESTEPS - i] * dpow_tbl[i]), ZERO);
+			opt_price[i] = std::max((exe_price - node_price[i]), ZERO);
 		}
-		// Move to earlier times
+		// Move to earlier times, in place: node j of a time step only needs the nodes j and j + 1 of the
+		// time step after it, and it is computed before node j + 1 is overwritten.
 		for (int i = OPT_TIMESTEPS - 1; i >= 0; i--) {
+			const fptype* row = node_row(node_price, scratch.stride, i);
 			for (int j = 0; j <= i; j++) {
-				tmp_val[j] = (p * opt_price[j] + (ONE - p) * opt_price[j+1]) * multiplier;
-			}
-			// If exercise is permitted at the node, then the model takes the greater of binomial and exercise value at the node.
-			for (int j = 0; j <= i; j++) {
-				fptype t1 = upow_tbl[i - j] * dpow_tbl[j];
-				fptype early_exe_value = std::max(exe_price - t1, ZERO);
-				opt_price[j] = std::max(early_exe_value, tmp_val[j]);
+				fptype binomial_value = (p * opt_price[j] + (ONE - p) * opt_price[j+1]) * multiplier;
+				// If exercise is permitted at the node, then the model takes the greater of binomial and exercise value at the node.
+				fptype early_exe_value = std::max(exe_price - row[j], ZERO);
+				opt_price[j] = std::max(early_exe_value, binomial_value);
 			}
 		}
 		priceResult[k] = opt_price[0];
 		*total_priceResult += priceResult[k];
-		delete[] opt_price;
-		delete[] upow_tbl;
-		delete[] dpow_tbl;
-		delete[] tmp_val;
 	}
 	return total_priceResult.get_value();
 }
@@ -178,12 +202,12 @@ fptype binomial_lattice_cilk_simd(OptionData* optionValues, fptype* priceResult)
 	const fptype ONE = fptype(1.);
 	double total_priceResult(0);
 	std::mutex mtx;
+	static WorkerArena arena;
 
 	cilk_for (int k = 0; k < NUM_OPTIONS; ++k) {
-		fptype* opt_price = new fptype[MAX_NTIMESTEPS];
-		fptype* upow_tbl = new fptype[MAX_NTIMESTEPS];
-		fptype* dpow_tbl = new fptype[MAX_NTIMESTEPS];
-		fptype* tmp_val  = new fptype[MAX_NTIMESTEPS];
+		LatticeScratch scratch = lattice_scratch(arena);
+		fptype* opt_price  = scratch.opt_price;
+		fptype* node_price = scratch.node_price;
 
 		fptype risk_free_rate = optionValues[k].r;
 		fptype stock_price    = optionValues[k].s;
@@ -193,49 +217,38 @@ fptype binomial_lattice_cilk_simd(OptionData* optionValues, fptype* priceResult)
 
 		deltat /= OPT_TIMESTEPS;
 
-		fptype u = exp(volatility * sqrt(deltat));
-		fptype d = exp(-volatility * sqrt(deltat));
+		fptype log_u = volatility * sqrt(deltat);
+		fptype u = exp(log_u);
+		fptype d = exp(-log_u);
 		fptype a = exp(risk_free_rate * deltat);
 		fptype multiplier = exp(-risk_free_rate * deltat);
 
 		fptype p = (a - d) / (u - d);
 
-		upow_tbl[0] = stock_price;
-		dpow_tbl[0] = ONE;
-
-		for (int i = 1; i <= OPT_TIMESTEPS; ++i) {
-			upow_tbl[i] = u * upow_tbl[i - 1];
-			dpow_tbl[i] = d * dpow_tbl[i - 1];
-		}
+		fill_node_prices(stock_price, log_u, scratch.stride, node_price);
 
 		// Initial values at expiration time
 #pragma simd
 		for (int i = 0; i <= OPT_TIMESTEPS; ++i) {
-			opt_price[i] = std::max((exe_price - upow_tbl[OPT_TIMESTEPS - i] * dpow_tbl[i]), ZERO);
+			opt_price[i] = std::max((exe_price - node_price[i]), ZERO);
 		}
-		// Move to earlier times
+		// Move to earlier times, in place: node j of a time step only needs the nodes j and j + 1 of the
+		// time step after it, and it is computed before node j + 1 is overwritten.
 		for (int i = OPT_TIMESTEPS - 1; i >= 0; --i) {
+			const fptype* row = node_row(node_price, scratch.stride, i);
 			// Vectorization is possible even with forward reference of the array opt_price (j and j+1)
 #pragma simd
 			for (int j = 0; j <= i; ++j) {
-				tmp_val[j] = (p * opt_price[j] + (ONE - p) * opt_price[j+1]) * multiplier;
-			}
-			// If exercise is permitted at the node, then the model takes the greater of binomial and exercise value at the node.
-#pragma simd
-			for (int j = 0; j <= i; ++j) {
-				fptype t1 = upow_tbl[i - j] * dpow_tbl[j];
-				fptype early_exe_value = std::max(exe_price - t1, ZERO);
-				opt_price[j] = std::max(early_exe_value, tmp_val[j]);
+				fptype binomial_value = (p * opt_price[j] + (ONE - p) * opt_price[j+1]) * multiplier;
+				// If exercise is permitted at the node, then the model takes the greater of binomial and exercise value at the node.
+				fptype early_exe_value = std::max(exe_price - row[j], ZERO);
+				opt_price[j] = std::max(early_exe_value, binomial_value);
 			}
 		}
 		priceResult[k] = opt_price[0];
 		mtx.lock();
 		total_priceResult+=priceResult[k];
 		mtx.unlock();
-		delete[] opt_price;
-		delete[] upow_tbl;
-		delete[] dpow_tbl;
-		delete[] tmp_val;
 	}
 	return total_priceResult;
 }
@@ -44,7 +44,7 @@ LLCOPTFLAGS ?= $(OPTFLAGS)
 CILKTOOLS=../../../cilktools
 ifeq (1,$(CILKSAN))
 CFLAGS += -fsanitize=thread
-CXXFlags += -fsanitize=thread
+CXXFLAGS += -fsanitize=thread
 DETACH2CILK += -instrument-cilk
 LDFLAGS += -L $(CILKTOOLS)/lib -lcilksan
 endif
@@ -28,7 +28,18 @@
 
 #include "DCT.h"
 #include "matrix.h"
+#include "dct_aan.h"
+#include "dct_islow.h"
 #include "timer.h"
+#include "bmp_io.h"
+#include "batch_pipeline.h"
+#include "jpeg_codec.h"
+#include "jpeg_tables.h"
+#include <cstring>
+#include <vector>
+
+//Quality of the quantization matrix (1 to 100) when none is given: the 90% matrix the sample always used
+#define DEFAULT_QUALITY 90
 
 //API for creating 8x8 DCT matrix
 // #if defined(__INTEL_COMPILER)
@@ -47,8 +58,8 @@
 // 	return;
 // }
 // #endif
-void create_DCT_serial(matrix_serial &x){
-	int size = x.row_size;
+void create_DCT_serial(matrix_8x8 &x){
+	int size = 8;
 	int temp[8];
 	for(int i = 0; i < size; i++)
 		temp[i] = i;
@@ -65,6 +76,37 @@ void create_DCT_serial(matrix_serial &x){
 	return;
 }
 
+//The 8x8 DCT matrix and its transpose are the same for every block: they are computed once, before
+//main. The quantization matrix is the luminance table of the JPEG specification (50% quality)
+//scaled to the quality asked for, computed once by set_quality before the blocks, which only read
+//the tables. Quantization multiplies by quant_reciprocal instead of dividing by quant. aan is the
+//quantization matrix with the scale factors of the butterflies of the AAN versions, islow the one
+//of the integer versions
+struct DCT_tables {
+	matrix_8x8 dct, dctinv, quant, quant_reciprocal;
+	aan_tables aan;
+	islow_tables islow;
+	DCT_tables(){
+		//Creation of 8x8 DCT matrix
+		create_DCT_serial(dct);
+		//Creating a transpose of DCT matrix
+		dct.transpose(dctinv);
+		set_quality(DEFAULT_QUALITY);
+	}
+	void set_quality(int quality){
+		unsigned char scaled[64];
+		jpeg::scale_quant_table(jpeg::luminance_quant, quality, scaled);
+		for(int i = 0; i < 64; i++)
+		{
+			quant.ptr[i] = scaled[i];
+			quant_reciprocal.ptr[i] = 1.f / quant.ptr[i];
+		}
+		create_aan_tables(quant.ptr, aan);
+		create_islow_tables(quant.ptr, islow);
+	}
+};
+static DCT_tables tables;
+
 
 //Processing API is having one Array Notation versions and another one in else block which is the plain AOS version
 
@@ -132,96 +174,365 @@ void create_DCT_serial(matrix_serial &x){
 //   	return;
 // }
 // #endif
-ALIGN void process_image_serial(rgb *indataset, rgb *outdataset, int startindex){
-	int size = 8;
-	int size_of_array = size * size;
-	matrix_serial dct(size), dctinv(size), interim(size), interim1(size), product(size), redinput(size), blueinput(size), greeninput(size), quant(size);
-	//Quantization matrix which does 50%, 90% and 10% quantization
-	float quant50[64] = {16.f, 11.f, 10.f, 16.f, 24.f, 40.f, 51.f, 61.f, 12.f, 12.f, 14.f, 19.f, 26.f, 58.f, 60.f, 55.f, 14.f, 13.f, 16.f, 24.f, 40.f, 57.f, 69.f, 56.f, 14.f, 17.f, 22.f, 29.f, 51.f, 87.f, 80.f, 62.f, 18.f, 22.f, 37.f, 56.f, 68.f, 109.f, 103.f, 77.f, 24.f, 35.f, 55.f, 64.f, 81.f, 104.f, 113.f, 92.f, 49.f, 64.f, 78.f, 87.f, 103.f, 121.f, 120.f, 101.f, 72.f, 92.f, 95.f, 98.f, 112.f, 100.f, 103.f, 99.f};
-	float quant90[64] = {3, 2, 2, 3, 5, 8, 10, 12, 2, 2, 3, 4, 5, 12, 12, 11, 3, 3, 3, 5, 8, 11, 14, 11, 3, 3, 4, 6, 10, 17, 16, 12, 4, 4, 7, 11, 14, 22, 21, 15, 5, 7, 11, 13, 16, 12, 23, 18, 10, 13, 16, 17, 21, 24, 24, 21, 14, 18, 19, 20, 22, 20, 20, 20};
-	float quant10[64] = {80, 60, 50, 80, 120, 200, 255, 255, 55, 60, 70, 95, 130, 255, 255, 255, 70, 65, 80, 120, 200, 255, 255, 255, 70, 85, 110, 145, 255, 255, 255, 255, 90, 110, 185, 255, 255, 255, 255, 255, 120, 175, 255, 255, 255, 255, 255, 255, 245, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255};
-	//memcpy(quant.ptr, quant50, sizeof(float)*64);
-	//memcpy(quant.ptr, quant90, sizeof(float)*64);
-	memcpy(quant.ptr, quant90, sizeof(float)*64);
-	//Creation of 8x8 DCT matrix
-	create_DCT_serial(dct);
-	//Creating a transpose of DCT matrix
-	dct.transpose(dctinv);
+// Description:
+// DCT, quantization, dequantization and IDCT of one channel of a block of 64 pixels. The channel is
+// read and written every 3 bytes, from the byte of the channel in the first pixel.
+//
+// [in]: input
+// [out]: output
+static void process_channel(const unsigned char *input, unsigned char *output){
+	matrix_8x8 channel, interim, product;
 	//Translating the pixels values from 0 - 255 range to -128 to 127 range
 	for(int i = 0; i < 64; i++)
 	{
-		redinput.ptr[i] = indataset[startindex+i].red;
-		redinput.ptr[i] -= 128;
+		channel.ptr[i] = input[3*i];
+		channel.ptr[i] -= 128;
 	}
-	//Computation of the discrete cosine transform of the image section of size 8x8 for red values
-	interim = dct * redinput *dctinv;
+	//Computation of the discrete cosine transform of the image section of size 8x8
+	interim = tables.dct * channel * tables.dctinv;
 	//Computation of quantization phase using the quantization matrix
 	for(int i = 0; i < 64; i++)
-		interim.ptr[i] = floor((interim.ptr[i]/quant.ptr[i]) + 0.5f);
+		interim.ptr[i] = floor((interim.ptr[i]*tables.quant_reciprocal.ptr[i]) + 0.5f);
 	//Computation of dequantizing phase using the same above quantization matrix
 	for(int i = 0; i < 64; i++)
-		interim.ptr[i] = floor((interim.ptr[i]*quant.ptr[i]) + 0.5f);
+		interim.ptr[i] = floor((interim.ptr[i]*tables.quant.ptr[i]) + 0.5f);
 	//Computation of Inverse Discrete Cosine Transform (IDCT)
-	product = dctinv * interim * dct;
+	product = tables.dctinv * interim * tables.dct;
 	for(int i = 0; i < 64; i++)
 	{
 		float temp = (product.ptr[i] + 128);
-		outdataset[startindex+i].red = (temp > 255.f)?255:(unsigned char)temp;
+		output[3*i] = (temp > 255.f)?255:((temp < 0.f)?0:(unsigned char)temp);
 	}
-	///////////////////////////
-	//Translating the pixels values from 0 - 255 range to -128 to 127 range
+}
+
+ALIGN void process_image_serial(rgb *indataset, rgb *outdataset, int startindex){
+	process_channel(&indataset[startindex].red, &outdataset[startindex].red);
+	process_channel(&indataset[startindex].blue, &outdataset[startindex].blue);
+	process_channel(&indataset[startindex].green, &outdataset[startindex].green);
+	return;
+}
+
+// Description:
+// Same as process_image_serial with the three channels transformed together: the block is
+// deinterleaved once into a tile per channel, every product reads the DCT matrix once for the three
+// tiles, and the tiles are interleaved back once. The images are the same as process_image_serial.
+//
+// [in]: indataset, startindex
+// [out]: outdataset
+ALIGN void process_image_fused(rgb *indataset, rgb *outdataset, int startindex){
+	matrix_8x8 channels[3], interim[3];
+	const rgb *input = indataset + startindex;
+	rgb *output = outdataset + startindex;
+	//Deinterleaving and translating the pixels values from 0 - 255 range to -128 to 127 range
 	for(int i = 0; i < 64; i++)
 	{
-		blueinput.ptr[i] = indataset[startindex+i].blue;
-		blueinput.ptr[i] -= 128;
+		channels[0].ptr[i] = input[i].red;
+		channels[1].ptr[i] = input[i].blue;
+		channels[2].ptr[i] = input[i].green;
+		for(int c = 0; c < 3; c++)
+			channels[c].ptr[i] -= 128;
 	}
-	//Computation of the discrete cosine transform of the image section of size 8x8 for blue values
-	interim = dct * blueinput *dctinv;
-	//Computation of quantization phase using the quantization matrix
-	for(int i = 0; i < 64; i++)
-		interim.ptr[i] = floor((interim.ptr[i]/quant.ptr[i]) + 0.5f);
-	//Computation of dequantizing phase using the same above quantization matrix
-	for(int i = 0; i < 64; i++)
-		interim.ptr[i] = floor((interim.ptr[i]*quant.ptr[i]) + 0.5f);
-	//Computation of Inverse Discrete Cosine Transform (IDCT)
-	product = dctinv * interim * dct;
+	//Computation of the discrete cosine transform of the three channels
+	multiply_left(tables.dct, channels, interim);
+	multiply_right(interim, tables.dctinv, channels);
+	//Computation of quantization and dequantizing phases using the quantization matrix
+	for(int c = 0; c < 3; c++)
+	{
+		for(int i = 0; i < 64; i++)
+		{
+			float value = floor((channels[c].ptr[i]*tables.quant_reciprocal.ptr[i]) + 0.5f);
+			channels[c].ptr[i] = floor((value*tables.quant.ptr[i]) + 0.5f);
+		}
+	}
+	//Computation of Inverse Discrete Cosine Transform (IDCT) of the three channels
+	multiply_left(tables.dctinv, channels, interim);
+	multiply_right(interim, tables.dct, channels);
+	//Interleaving the channels back
 	for(int i = 0; i < 64; i++)
 	{
-		float temp = product.ptr[i] + 128;
-		outdataset[startindex+i].blue = (temp > 255.f)?255:(unsigned char)temp;
+		float temp[3];
+		unsigned char value[3];
+		for(int c = 0; c < 3; c++)
+		{
+			temp[c] = (channels[c].ptr[i] + 128);
+			value[c] = (temp[c] > 255.f)?255:((temp[c] < 0.f)?0:(unsigned char)temp[c]);
+		}
+		output[i].red = value[0];
+		output[i].blue = value[1];
+		output[i].green = value[2];
 	}
-	////////////////////////////
+	return;
+}
+
+// Description:
+// Same as process_channel with the AAN butterflies, which compute the exact DCT (with pi, where the
+// matrix of create_DCT_serial uses 3.14), so the images differ slightly from the other versions.
+// Quantization divides and dequantization multiplies by the tables of the butterflies.
+//
+// [in]: input
+// [out]: output
+static void process_channel_AAN(const unsigned char *input, unsigned char *output){
+	float block[64];
 	//Translating the pixels values from 0 - 255 range to -128 to 127 range
 	for(int i = 0; i < 64; i++)
 	{
-		greeninput.ptr[i] = indataset[startindex+i].green;
-		greeninput.ptr[i] -= 128;
+		block[i] = input[3*i];
+		block[i] -= 128;
 	}
-	//Computation of the discrete cosine transform of the image section of size 8x8 for green values
-	interim = dct * greeninput *dctinv;
-	//Computation of quantization phase using the quantization matrix
+	//DCT, which gives the coefficients divided by the quantization matrix, and quantization
+	aan_forward(block, tables.aan);
 	for(int i = 0; i < 64; i++)
-		interim.ptr[i] = floor((interim.ptr[i]/quant.ptr[i]) + 0.5f);
-	//Computation of dequantizing phase using the same above quantization matrix
+		block[i] = floor(block[i] + 0.5f);
+	//Dequantization and IDCT
+	aan_inverse(block, tables.aan);
 	for(int i = 0; i < 64; i++)
-		interim.ptr[i] = floor((interim.ptr[i]*quant.ptr[i]) + 0.5f);
-	//Computation of Inverse Discrete Cosine Transform (IDCT)
-	product = dctinv * interim * dct;
+	{
+		float temp = (block[i] + 128);
+		output[3*i] = (temp > 255.f)?255:((temp < 0.f)?0:(unsigned char)temp);
+	}
+}
+
+ALIGN void process_image_AAN(rgb *indataset, rgb *outdataset, int startindex){
+	process_channel_AAN(&indataset[startindex].red, &outdataset[startindex].red);
+	process_channel_AAN(&indataset[startindex].blue, &outdataset[startindex].blue);
+	process_channel_AAN(&indataset[startindex].green, &outdataset[startindex].green);
+	return;
+}
+
+// Description:
+// Same as process_channel with the integer DCT and IDCT of dct_islow.h, in 16 bit fixed point.
+// The images differ slightly from the float versions.
+//
+// [in]: input
+// [out]: output
+static void process_channel_islow(const unsigned char *input, unsigned char *output){
+	ALIGN short block[64];
+	//Translating the pixels values from 0 - 255 range to -128 to 127 range
+	for(int i = 0; i < 64; i++)
+		block[i] = (short)(input[3*i] - 128);
+	//DCT, quantization, dequantization and IDCT
+	islow_forward(block);
+	islow_quantize(block, tables.islow);
+	islow_inverse(block, tables.islow);
 	for(int i = 0; i < 64; i++)
 	{
-		float temp = product.ptr[i] + 128;
-		outdataset[startindex+i].green = (temp > 255.f)?255:(unsigned char)temp;
+		int temp = block[i] + 128;
+		output[3*i] = (temp > 255)?255:((temp < 0)?0:(unsigned char)temp);
 	}
+}
+
+ALIGN void process_image_islow(rgb *indataset, rgb *outdataset, int startindex){
+	process_channel_islow(&indataset[startindex].red, &outdataset[startindex].red);
+	process_channel_islow(&indataset[startindex].blue, &outdataset[startindex].blue);
+	process_channel_islow(&indataset[startindex].green, &outdataset[startindex].green);
 	return;
 }
 
+//Transforms the 8x8 block of the 64 pixels from startindex, stored row after row
+typedef void (*block_kernel)(rgb *indataset, rgb *outdataset, int startindex);
+
+// Description:
+// Runs kernel on the 8x8 tiles of block row block_row (image rows 8*block_row to 8*block_row+7)
+// of a w x h image, from left to right. Every tile is gathered into 64 contiguous pixels, the
+// rows and columns past the bottom and right edges of the image repeating the last pixel of the
+// image, and only the pixels within the image are written back. A block row is 8 image rows, so
+// its tiles are read from the same few cache lines of every row.
+//
+// [in]: indata, w, h, block_row, kernel
+// [out]: outdata
+static void process_block_row(rgb *indata, rgb *outdata, int w, int h, int block_row, block_kernel kernel){
+	ALIGN rgb tile_in[64];
+	ALIGN rgb tile_out[64];
+	int first_row = block_row * 8;
+	int rows = (h - first_row < 8) ? h - first_row : 8;
+	for(int x = 0; x < w; x += 8)
+	{
+		int columns = (w - x < 8) ? w - x : 8;
+		for(int r = 0; r < 8; r++)
+		{
+			const rgb *source = indata + ((first_row + ((r < rows) ? r : rows - 1)) * w) + x;
+			memcpy(&tile_in[r * 8], source, columns * sizeof(rgb));
+			for(int c = columns; c < 8; c++)
+				tile_in[(r * 8) + c] = source[columns - 1];
+		}
+		kernel(tile_in, tile_out, 0);
+		for(int r = 0; r < rows; r++)
+			memcpy(outdata + ((first_row + r) * w) + x, &tile_out[r * 8], columns * sizeof(rgb));
+	}
+}
+
+// Description:
+// Runs version choice of the DCT on a w x h image, timed by t. Returns false for an unknown version.
+//
+// [in]: choice, indata, w, h
+// [out]: outdata, t
+static bool run_version(int choice, rgb *indata, rgb *outdata, int w, int h, CUtilTimer &t){
+	//Number of rows of 8x8 blocks, the last one completed by repeating the last row of the image
+	int block_rows = (h + 7) / 8;
+	switch(choice){
+		case 1:	t.start();
+			for(int i = 0; i < block_rows; i++)
+			{
+				process_block_row(indata, outdata, w, h, i, process_image_serial);
+			}
+			t.stop();
+			break;
+		// AAN butterflies
+		case 5: t.start();
+			for(int i = 0; i < block_rows; i++)
+			{
+				process_block_row(indata, outdata, w, h, i, process_image_AAN);
+			}
+			t.stop();
+			break;
+		// Channels transformed together
+		case 9: t.start();
+			for(int i = 0; i < block_rows; i++)
+			{
+				process_block_row(indata, outdata, w, h, i, process_image_fused);
+			}
+			t.stop();
+			break;
+		// Integer DCT
+		case 7: t.start();
+			for(int i = 0; i < block_rows; i++)
+			{
+				process_block_row(indata, outdata, w, h, i, process_image_islow);
+			}
+			t.stop();
+			break;
+#ifdef __INTEL_COMPILER
+		case 2: t.start();
+			
+			for(int i = 0; i < block_rows; i++)
+			{
+				// process_block_row(indata, outdata, w, h, i, process_image_AN);
+				process_block_row(indata, outdata, w, h, i, process_image_serial);
+			}
+			t.stop();
+			break;
+		case 3: t.start();
+			
+			cilk_for(int i = 0; i < block_rows; i++)
+			{
+				process_block_row(indata, outdata, w, h, i, process_image_serial);
+			}
+			t.stop();
+			break;
+		case 4: t.start();
+			
+			cilk_for(int i = 0; i < block_rows; i++)
+			{
+				process_block_row(indata, outdata, w, h, i, process_image_serial);
+				// process_block_row(indata, outdata, w, h, i, process_image_AN);
+			}
+			t.stop();
+			break;
+		// AAN butterflies + cilk_for
+		case 6: t.start();
+			cilk_for(int i = 0; i < block_rows; i++)
+			{
+				process_block_row(indata, outdata, w, h, i, process_image_AAN);
+			}
+			t.stop();
+			break;
+		// Integer DCT + cilk_for
+		case 8: t.start();
+			cilk_for(int i = 0; i < block_rows; i++)
+			{
+				process_block_row(indata, outdata, w, h, i, process_image_islow);
+			}
+			t.stop();
+			break;
+		// Channels transformed together + cilk_for
+		case 10: t.start();
+			cilk_for(int i = 0; i < block_rows; i++)
+			{
+				process_block_row(indata, outdata, w, h, i, process_image_fused);
+			}
+			t.stop();
+			break;
+#endif
+		default: cout<<"Wrong choice\n";
+			return false;
+		}
+	return true;
+}
+
+// Description:
+// Peak signal to noise ratio in dB of the image b against the image a, of size bytes each.
+// Identical images give infinity.
+//
+// [in]: a, b, size
+static double psnr(const unsigned char *a, const unsigned char *b, size_t size){
+	double squared_error = 0.0;
+	for(size_t i = 0; i < size; i++)
+	{
+		double difference = (double)a[i] - b[i];
+		squared_error += difference * difference;
+	}
+	double mse = squared_error / size;
+	return (mse > 0.0) ? 10.0 * log10((255.0 * 255.0) / mse) : HUGE_VAL;
+}
+
+// Description:
+// Compare mode: runs the versions first and second of the DCT on input, and prints their clock ticks,
+// the PSNR of both images against the input, and the largest difference and the number of different
+// bytes between the two images.
+//
+// [in]: input, first, second
+int compare_versions(char *input, int first, int second){
+	bmpio::MappedBMP in;
+	if(!in.open(input)){
+		cout<<"The input file could not be opened. Program will be exiting\n";
+		return 0;
+	}
+	if(in.bits_per_pixel() != 24){
+		cout<<"This is not a RGB image\n";
+		return 0;
+	}
+	int w = in.width(), h = in.height();
+	size_t size = (size_t)w * h * 3;
+	unsigned char *indata = (unsigned char *)_mm_malloc(size, ALIGNMENT);
+	unsigned char *outdata[2] = {(unsigned char *)_mm_malloc(size, ALIGNMENT), (unsigned char *)_mm_malloc(size, ALIGNMENT)};
+	if(indata == NULL || outdata[0] == NULL || outdata[1] == NULL){
+		cout<<"Unable to allocate the memory for bitmap date\n";
+		return 0;
+	}
+	in.copy_pixels(indata);
+	in.close();
+
+	int versions[2] = {first, second};
+	for(int v = 0; v < 2; v++)
+	{
+		CUtilTimer t;
+		if(!run_version(versions[v], (rgb *)indata, (rgb *)outdata[v], w, h, t))
+			return 0;
+		cout<<"Version "<<versions[v]<<": "<<t.get_ticks()<<" ticks, PSNR "<<psnr(indata, outdata[v], size)<<" dB\n";
+	}
+	int largest = 0;
+	size_t different = 0;
+	for(size_t i = 0; i < size; i++)
+	{
+		int difference = abs((int)outdata[0][i] - (int)outdata[1][i]);
+		if(difference > largest)
+			largest = difference;
+		if(difference)
+			different++;
+	}
+	cout<<"Largest difference "<<largest<<", "<<different<<" of "<<size<<" bytes differ, PSNR between the versions "
+		<<psnr(outdata[0], outdata[1], size)<<" dB\n";
+	_mm_free(indata);
+	_mm_free(outdata[0]);
+	_mm_free(outdata[1]);
+	return 0;
+}
 
 //This API does the reading and writing from/to the .bmp file. Also invokes the image processing API from here
 int read_process_write(char* input, char *output, int choice) {
 
-    FILE *fp,*out;
-    bitmap_header* hp;
-    size_t n;
+    bmpio::MappedBMP in;
+    const bitmap_header* hp;
     CUtilTimer t;
 	#ifdef PERF_NUM
 	long long avg_ticks = 0;
@@ -229,28 +540,17 @@ int read_process_write(char* input, char *output, int choice) {
     // Making sure the AOS alignes to an address which is multiple of 16 to support vectorization 
     ALIGN rgb *indata, *outdata;
 
-    //Instantiating a file handle to open a input BMP file in binary mode
-    fp = fopen(input, "rb");
-    if(fp==NULL){
+    //Mapping the input BMP file into memory. The header and the pixels are read in place from the mapping
+    if(!in.open(input)){
         cout<<"The input file could not be opened. Program will be exiting\n";
 	return 0;
     }
-
-
-    //Allocating memory for storing the bitmap header information which will be retrived from input image file
-    hp=(bitmap_header*)malloc(sizeof(bitmap_header));
-    if(hp==NULL)
-    {
-	cout<<"Unable to allocate the memory for bitmap header\n";
+    //The output is written while the input is still mapped, so they must be different files
+    if(bmpio::same_file(input, output)){
+        cout<<"The output file must not be the input file. Program will be exiting\n";
         return 0;
     }
-
-    //Reading from input file the bitmap header information which is inturn stored in memory allocated in the previous step
-    n=fread(hp, sizeof(bitmap_header), 1, fp);
-        if(n<1){
-            cout<<"Read error from the file. No bytes were read from the file. Program exiting \n";
-            return 0;        
-        }
+    hp=(const bitmap_header*)in.header();
 
     if(hp->bitsperpixel != 24){
         cout<<"This is not a RGB image\n";
@@ -266,15 +566,8 @@ int read_process_write(char* input, char *output, int choice) {
         return 0;
     }
 
-    // Setting the File descriptor to the starting point in the input file where the bitmap data(payload) starts
-    fseek(fp,sizeof(char)*hp->fileheader.dataoffset,SEEK_SET);
-
-    // Reading the bitmap data from the input bmp file to the memory allocated in the previous step
-    n=fread(indata, sizeof(rgb), (size_of_image), fp);
-    if(n<1){
-        cout<<"Read error from the file. No bytes were read from the file. Program exiting \n";
-        return 0;
-    }
+    // Copying the bitmap data from the mapping to the aligned buffer, without the padding at the end of the rows
+    in.copy_pixels((unsigned char *)indata);
 	
 	//Allocate memory for storing the bitmap data of the processed image
     outdata = (rgb *)_mm_malloc((sizeof(rgb)*(size_of_image)), ALIGNMENT);
@@ -287,76 +580,21 @@ int read_process_write(char* input, char *output, int choice) {
 	for(int j = 0; j < 5; j++)
 	{
 #endif
-	switch(choice){
-		case 1:	t.start();
-			int startindex;
-			for(int i = 0; i < (size_of_image)/64; i++)
-			{
-				startindex = (i * 64);
-				process_image_serial(indata, outdata, startindex);
-			}
-			t.stop();
-			break;
-#ifdef __INTEL_COMPILER
-		case 2: t.start();
-			
-			for(int i = 0; i < (size_of_image)/64; i++)
-			{
-				startindex = (i * 64);
-				// process_image_AN(indata, outdata, startindex);
-				process_image_serial(indata, outdata, startindex);
-			}
-			t.stop();
-			break;
-		case 3: t.start();
-			
-			cilk_for(int i = 0; i < (size_of_image)/64; i++)
-			{
-				startindex = (i * 64);
-				process_image_serial(indata, outdata, startindex);
-			}
-			t.stop();
-			break;
-		case 4: t.start();
-			
-			cilk_for(int i = 0; i < (size_of_image)/64; i++)
-			{
-				startindex = (i * 64);
-				process_image_serial(indata, outdata, startindex);
-				// process_image_AN(indata, outdata, startindex);
-			}
-			t.stop();
-			break;
-#endif
-		default: cout<<"Wrong choice\n";
-			break;
-		}
+	// An unknown version leaves outdata unset: nothing is written
+	if(!run_version(choice, indata, outdata, hp->width, hp->height, t)){
+		_mm_free(indata);
+		_mm_free(outdata);
+		return 0;
+	}
 #ifdef PERF_NUM
 		avg_ticks += t.get_ticks();
 	}
 	avg_ticks /= 5;
 #endif
 
-	// Opening an output file to which the processed result will be written
-    out = fopen(output, "wb");
-    if(out==NULL){
-        cout<<"The file could not be opened. Program will be exiting\n";
-        return 0;
-    }
-
-    // Writing the bitmap header which we copied from the input file to the output file. We need not make any changes because we haven't made any change to the image size or compression type.
-    n=fwrite(hp,sizeof(char),sizeof(bitmap_header),out);
-    if(n<1){
-        cout<<"Write error to the file. No bytes were wrtten to the file. Program exiting \n";
-        return 0;
-    }
-
-    //Setting the file descriptor to point to the location where the bitmap data is to be written 
-    fseek(out,sizeof(char)*hp->fileheader.dataoffset,SEEK_SET);
-
-    // Writing the bitmap data of the processed image to the output file
-    n=fwrite(outdata,sizeof(rgb),(size_of_image),out);
-    if(n<1){
+    // Writing the header copied from the input file and the bitmap data of the processed image to the output file.
+    // We need not make any changes to the header because we haven't made any change to the image size or compression type.
+    if(!bmpio::write_bmp(output, in.header(), in.data_offset(), (unsigned char *)outdata, hp->width, hp->height, 24)){
         cout<<"Write error to the file. No bytes were wrtten to the file. Program exiting \n";
         return 0;
     }
@@ -366,18 +604,209 @@ int read_process_write(char* input, char *output, int choice) {
 #else
 	cout<<t.get_ticks()<<"\n";
 #endif
-    // Closing all file handles and also freeing all the dynamically allocated memory
-    fclose(fp);
-    fclose(out);
-    free(hp);
+    // Unmapping the input file and also freeing all the dynamically allocated memory
+    in.close();
     _mm_free(indata);
     _mm_free(outdata);
     return 0;
 }
 
+#ifdef __INTEL_COMPILER
+//Filter used by the batch mode, the same loop as choice 3
+void batch_filter(unsigned char *in, unsigned char *out, int w, int h){
+	cilk_for(int i = 0; i < (h + 7) / 8; i++)
+	{
+		process_block_row((rgb *)in, (rgb *)out, w, h, i, process_image_serial);
+	}
+}
+
+// Description:
+// JPEG mode: encodes input (a 24 bit .bmp file) to output, then decodes the file again to check it.
+// Prints the clock ticks of every stage of the encoder and of the decoder, the size of the file,
+// the PSNR of the decoded image and, on the last line, the clock ticks of the whole encoder.
+//
+// [in]: input, output, subsampling ("420" or "444"), restart_interval (MCUs, 0 for one row of MCUs), quality
+int encode_jpeg(char *input, char *output, const char *subsampling, int restart_interval, int quality){
+	bmpio::MappedBMP in;
+	if(!in.open(input)){
+		cout<<"The input file could not be opened. Program will be exiting\n";
+		return 0;
+	}
+	if(in.bits_per_pixel() != 24){
+		cout<<"This is not a RGB image\n";
+		return 0;
+	}
+	int w = in.width(), h = in.height();
+	std::vector<unsigned char> pixels((size_t)w * h * 3);
+	in.copy_pixels(&pixels[0]);
+	in.close();
+
+	jpeg::EncoderOptions options;
+	options.subsampling = (strcmp(subsampling, "444") == 0) ? jpeg::SUBSAMPLING_444 : jpeg::SUBSAMPLING_420;
+	options.restart_interval = restart_interval;
+	options.quality = quality;
+	std::vector<unsigned char> file;
+	jpeg::CodecStats encoded, decoded;
+	if(!jpeg::encode(&pixels[0], w, h, options, file, &encoded)){
+		cout<<"The image is too large for a JPEG file\n";
+		return 0;
+	}
+	FILE *out = fopen(output, "wb");
+	if(out == NULL){
+		cout<<"The output file could not be opened. Program will be exiting\n";
+		return 0;
+	}
+	size_t written = fwrite(&file[0], 1, file.size(), out);
+	fclose(out);
+	if(written != file.size()){
+		cout<<"Write error to the file. Program exiting \n";
+		return 0;
+	}
+
+	std::vector<unsigned char> decoded_pixels;
+	int decoded_w, decoded_h;
+	if(!jpeg::decode(&file[0], file.size(), decoded_pixels, decoded_w, decoded_h, &decoded) || decoded_w != w || decoded_h != h){
+		cout<<"The encoded file could not be decoded\n";
+		return 0;
+	}
+
+	cout<<"Encoder: color conversion "<<encoded.color_ticks<<", DCT and quantization "<<encoded.transform_ticks
+		<<", Huffman coding "<<encoded.entropy_ticks<<" ticks, "<<encoded.intervals<<" restart intervals\n";
+	cout<<"Decoder: Huffman decoding "<<decoded.entropy_ticks<<", dequantization and IDCT "<<decoded.transform_ticks
+		<<", color conversion "<<decoded.color_ticks<<" ticks\n";
+	cout<<file.size()<<" bytes, "<<(8.0 * file.size()) / ((double)w * h)<<" bits per pixel, PSNR "
+		<<psnr(&pixels[0], &decoded_pixels[0], pixels.size())<<" dB\n";
+	cout<<encoded.color_ticks + encoded.transform_ticks + encoded.entropy_ticks<<"\n";
+	return 0;
+}
+
+// Description:
+// Decodes input, a JPEG file written by encode_jpeg, to output as a 24 bit .bmp file. Prints the
+// clock ticks of the whole decoder on the last line.
+//
+// [in]: input, output
+int decode_jpeg(char *input, char *output){
+	FILE *in = fopen(input, "rb");
+	if(in == NULL){
+		cout<<"The input file could not be opened. Program will be exiting\n";
+		return 0;
+	}
+	std::vector<unsigned char> file;
+	unsigned char chunk[4096];
+	size_t n;
+	while((n = fread(chunk, 1, sizeof(chunk), in)) > 0)
+		file.insert(file.end(), chunk, chunk + n);
+	fclose(in);
+
+	std::vector<unsigned char> pixels;
+	int w, h;
+	jpeg::CodecStats decoded;
+	if(file.empty() || !jpeg::decode(&file[0], file.size(), pixels, w, h, &decoded)){
+		cout<<"This is not a baseline JPEG file with 3 components\n";
+		return 0;
+	}
+
+	bitmap_header header;
+	memset(&header, 0, sizeof(header));
+	header.fileheader.filetype[0] = 'B';
+	header.fileheader.filetype[1] = 'M';
+	header.fileheader.dataoffset = sizeof(header);
+	header.headersize = sizeof(header) - sizeof(file_header);
+	header.width = w;
+	header.height = h;
+	header.planes = 1;
+	header.bitsperpixel = 24;
+	header.bitmapsize = (unsigned int)(bmpio::row_stride(w, 24) * h);
+	header.fileheader.filesize = header.fileheader.dataoffset + header.bitmapsize;
+	if(!bmpio::write_bmp(output, (const unsigned char *)&header, sizeof(header), &pixels[0], w, h, 24)){
+		cout<<"Write error to the file. No bytes were wrtten to the file. Program exiting \n";
+		return 0;
+	}
+	cout<<"Huffman decoding "<<decoded.entropy_ticks<<", dequantization and IDCT "<<decoded.transform_ticks
+		<<", color conversion "<<decoded.color_ticks<<" ticks, "<<decoded.intervals<<" restart intervals\n";
+	cout<<decoded.entropy_ticks + decoded.transform_ticks + decoded.color_ticks<<"\n";
+	return 0;
+}
+
+// Description:
+// Sweep mode: for a range of qualities, runs version choice of the DCT and the JPEG encoder on
+// input, and prints the clock ticks and the PSNR of both and the bits per pixel of the JPEG file.
+//
+// [in]: input, choice, subsampling ("420" or "444")
+int sweep_quality(char *input, int choice, const char *subsampling){
+	static const int qualities[] = {10, 25, 50, 75, 90, 95, 100};
+	bmpio::MappedBMP in;
+	if(!in.open(input)){
+		cout<<"The input file could not be opened. Program will be exiting\n";
+		return 0;
+	}
+	if(in.bits_per_pixel() != 24){
+		cout<<"This is not a RGB image\n";
+		return 0;
+	}
+	int w = in.width(), h = in.height();
+	size_t size = (size_t)w * h * 3;
+	rgb *indata = (rgb *)_mm_malloc(size, ALIGNMENT);
+	rgb *outdata = (rgb *)_mm_malloc(size, ALIGNMENT);
+	if(indata == NULL || outdata == NULL){
+		cout<<"Unable to allocate the memory for bitmap date\n";
+		return 0;
+	}
+	in.copy_pixels((unsigned char *)indata);
+	in.close();
+
+	jpeg::EncoderOptions options;
+	options.subsampling = (strcmp(subsampling, "444") == 0) ? jpeg::SUBSAMPLING_444 : jpeg::SUBSAMPLING_420;
+	std::vector<unsigned char> file, decoded_pixels;
+	cout<<"quality\tDCT ticks\tDCT PSNR\tJPEG ticks\tJPEG bits per pixel\tJPEG PSNR\n";
+	for(int q = 0; q < (int)(sizeof(qualities) / sizeof(qualities[0])); q++)
+	{
+		CUtilTimer t;
+		tables.set_quality(qualities[q]);
+		if(!run_version(choice, indata, outdata, w, h, t))
+			break;
+		cout<<qualities[q]<<"\t"<<t.get_ticks()<<"\t"<<psnr((unsigned char *)indata, (unsigned char *)outdata, size)<<"\t";
+
+		jpeg::CodecStats encoded;
+		int decoded_w, decoded_h;
+		options.quality = qualities[q];
+		if(!jpeg::encode((unsigned char *)indata, w, h, options, file, &encoded)
+			|| !jpeg::decode(&file[0], file.size(), decoded_pixels, decoded_w, decoded_h, NULL)){
+			cout<<"The image could not be encoded\n";
+			break;
+		}
+		cout<<encoded.color_ticks + encoded.transform_ticks + encoded.entropy_ticks<<"\t"
+			<<(8.0 * file.size()) / ((double)w * h)<<"\t"<<psnr((unsigned char *)indata, &decoded_pixels[0], size)<<"\n";
+	}
+	_mm_free(indata);
+	_mm_free(outdata);
+	return 0;
+}
+#endif
+
 int main(int argc, char *argv[]) {
+#ifdef __INTEL_COMPILER
+    if(argc > 1 && strcmp(argv[1], "-batch") == 0)
+        return batch::batch_main(argc, argv, batch_filter);
+    if(argc > 3 && strcmp(argv[1], "-jpeg") == 0)
+        return encode_jpeg(argv[2], argv[3], (argc > 4) ? argv[4] : "420", (argc > 5) ? atoi(argv[5]) : 0,
+                           (argc > 6) ? atoi(argv[6]) : jpeg::EncoderOptions().quality);
+    if(argc > 3 && strcmp(argv[1], "-decode") == 0)
+        return decode_jpeg(argv[2], argv[3]);
+    if(argc > 2 && strcmp(argv[1], "-sweep") == 0)
+        return sweep_quality(argv[2], (argc > 3) ? atoi(argv[3]) : 3, (argc > 4) ? argv[4] : "420");
+#endif
+    if(argc > 4 && strcmp(argv[1], "-compare") == 0)
+        return compare_versions(argv[2], atoi(argv[3]), atoi(argv[4]));
     if(argc < 3){
-        cout<<"Program usage is <modified_program> <inputfile.bmp> <outputfile.bmp>\n";
+        cout<<"Program usage is <modified_program> <inputfile.bmp> <outputfile.bmp> [version] [quality]\n";
+#ifdef __INTEL_COMPILER
+        cout<<"              or <modified_program> -batch <outputdir> <inputfile.bmp | inputdir> ...\n";
+        cout<<"              or <modified_program> -jpeg <inputfile.bmp> <outputfile.jpg> [420 | 444] [restart interval] [quality]\n";
+        cout<<"              or <modified_program> -decode <inputfile.jpg> <outputfile.bmp>\n";
+        cout<<"              or <modified_program> -sweep <inputfile.bmp> [version] [420 | 444]\n";
+#endif
+        cout<<"              or <modified_program> -compare <inputfile.bmp> <version> <version>\n";
         return 0;
     }
 	int choice = 3;
@@ -388,7 +817,24 @@ int main(int argc, char *argv[]) {
 //	cout<<"3) Serial + cilk_for version\n";
 //	cout<<"4) Array Notation + cilk_for version\n";
 //#endif
+//	cout<<"5) AAN butterflies version\n";
+//#ifdef __INTEL_COMPILER
+//	cout<<"6) AAN butterflies + cilk_for version\n";
+//#endif
+//	cout<<"7) Integer DCT version\n";
+//#ifdef __INTEL_COMPILER
+//	cout<<"8) Integer DCT + cilk_for version\n";
+//#endif
+//	cout<<"9) Fused channels version\n";
+//#ifdef __INTEL_COMPILER
+//	cout<<"10) Fused channels + cilk_for version\n";
+//#endif
 //	cin>>choice;
+    if(argc > 3)
+        choice = atoi(argv[3]);
+    //Quality of the quantization matrix, from 1 to 100
+    if(argc > 4)
+        tables.set_quality(atoi(argv[4]));
     read_process_write(argv[1], argv[2], choice);
 #ifdef _WIN32
 	system("PAUSE");
@@ -0,0 +1,82 @@
+//==============================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ===============================================================
+
+// Batch mode shared by the image filter samples: many BMP files go through
+// decode -> filter -> encode as a three stage pipeline.
+// At step k the decode of image k+2, the filter of image k+1 and the encode of image k run
+// concurrently, each on its own slot of a pool of BATCH_SLOTS buffers, so at most BATCH_SLOTS
+// images are in flight and the buffers are reused from one image to the next.
+// The same files are copied in every sample which has a batch mode, like bmp_io.h.
+
+#ifndef BATCH_PIPELINE_H
+#define BATCH_PIPELINE_H
+
+#include <string>
+#include <vector>
+
+namespace batch {
+
+// One slot per pipeline stage
+const int BATCH_SLOTS = 3;
+
+// Latency buckets: bucket k counts the durations in [2^k, 2^(k+1)) microseconds
+const int HISTOGRAM_BUCKETS = 24;
+
+// Filters a packed 24 bit image of width x height pixels from in to out.
+// Both buffers are 32 byte aligned
+typedef void (*filter_function)(unsigned char* in, unsigned char* out, int width, int height);
+
+class LatencyHistogram {
+public:
+	LatencyHistogram();
+	void add(double seconds);
+	// Prints the count, mean and max, then one line per non empty bucket
+	void print(const char* name) const;
+private:
+	long long m_counts[HISTOGRAM_BUCKETS];
+	long long m_total_count;
+	double m_total, m_max;
+};
+
+struct BatchStats {
+	int images;     // images filtered and written
+	int failures;   // files which could not be read or written
+	double seconds; // wall time of the whole batch
+	LatencyHistogram decode, filter, encode;
+};
+
+// Expands the arguments into a list of BMP files: a directory stands for every .bmp file in it
+// (sorted by name), anything else is taken as a file name
+std::vector<std::string> list_images(char** arguments, int count);
+
+// Description:
+// Runs every image of inputs through filter; the result for <dir>/<name>.bmp is written
+// to <output_dir>/<name>.bmp. Nothing is run if output_dir is the directory of one of the inputs,
+// since the outputs would overwrite them.
+//
+// [in]: inputs, output_dir, filter
+// [out]: stats, false if output_dir holds one of the inputs
+bool run_batch(const std::vector<std::string>& inputs, const std::string& output_dir,
+			   filter_function filter, BatchStats& stats);
+
+// Description:
+// Batch mode entry point for the samples: <program> -batch <output_dir> <image.bmp | dir> ...
+// Prints the latency histograms and the throughput, and the time in seconds on the last line.
+//
+// [in]: argc, argv (argv[1] is "-batch"), filter
+// [out]: exit code
+int batch_main(int argc, char** argv, filter_function filter);
+
+} // namespace batch
+
+#endif // BATCH_PIPELINE_H
@@ -0,0 +1,186 @@
+//=======================================================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ======================================================================================
+#include "dct_aan.h"
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+// Scale factor of coefficient k left by the butterflies: 1 for k = 0, sqrt(2) * cos(k * pi / 16) otherwise
+static const double aan_scale[8] = {
+	1.0, 1.387039845, 1.306562965, 1.175875602, 1.0, 0.785694958, 0.541196100, 0.275899379
+};
+
+void create_aan_tables(const float quant[64], aan_tables &tables){
+	for(int u = 0; u < 8; u++)
+	{
+		for(int v = 0; v < 8; v++)
+		{
+			// Both 1D passes also scale the coefficients by sqrt(8), hence the factors 8
+			double scale = aan_scale[u] * aan_scale[v];
+			tables.forward[(u * 8) + v] = (float)(1.0 / (quant[(u * 8) + v] * scale * 8.0));
+			tables.inverse[(u * 8) + v] = (float)(quant[(u * 8) + v] * scale / 8.0);
+		}
+	}
+}
+
+// The butterflies are written once for both a single float and, with Intel(R) AVX, a register of
+// 8 floats holding the same position in the 8 rows or columns of a block
+static inline float add(float a, float b) { return a + b; }
+static inline float sub(float a, float b) { return a - b; }
+static inline float mul(float a, float c) { return a * c; }
+#if defined(__AVX__)
+static inline __m256 add(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+static inline __m256 sub(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+static inline __m256 mul(__m256 a, float c) { return _mm256_mul_ps(a, _mm256_set1_ps(c)); }
+#endif
+
+// 8 point forward DCT, in place: d[0..7] are the values, then the scaled coefficients
+template<typename V> static inline void forward_butterfly(V d[8]){
+	V tmp0 = add(d[0], d[7]), tmp7 = sub(d[0], d[7]);
+	V tmp1 = add(d[1], d[6]), tmp6 = sub(d[1], d[6]);
+	V tmp2 = add(d[2], d[5]), tmp5 = sub(d[2], d[5]);
+	V tmp3 = add(d[3], d[4]), tmp4 = sub(d[3], d[4]);
+
+	// Even part
+	V tmp10 = add(tmp0, tmp3), tmp13 = sub(tmp0, tmp3);
+	V tmp11 = add(tmp1, tmp2), tmp12 = sub(tmp1, tmp2);
+	d[0] = add(tmp10, tmp11);
+	d[4] = sub(tmp10, tmp11);
+	V z1 = mul(add(tmp12, tmp13), 0.707106781f);
+	d[2] = add(tmp13, z1);
+	d[6] = sub(tmp13, z1);
+
+	// Odd part
+	tmp10 = add(tmp4, tmp5);
+	tmp11 = add(tmp5, tmp6);
+	tmp12 = add(tmp6, tmp7);
+	V z5 = mul(sub(tmp10, tmp12), 0.382683433f);
+	V z2 = add(mul(tmp10, 0.541196100f), z5);
+	V z4 = add(mul(tmp12, 1.306562965f), z5);
+	V z3 = mul(tmp11, 0.707106781f);
+	V z11 = add(tmp7, z3), z13 = sub(tmp7, z3);
+	d[5] = add(z13, z2);
+	d[3] = sub(z13, z2);
+	d[1] = add(z11, z4);
+	d[7] = sub(z11, z4);
+}
+
+// 8 point inverse DCT, in place: d[0..7] are the scaled coefficients, then the values
+template<typename V> static inline void inverse_butterfly(V d[8]){
+	// Even part
+	V tmp10 = add(d[0], d[4]), tmp11 = sub(d[0], d[4]);
+	V tmp13 = add(d[2], d[6]);
+	V tmp12 = sub(mul(sub(d[2], d[6]), 1.414213562f), tmp13);
+	V tmp0 = add(tmp10, tmp13), tmp3 = sub(tmp10, tmp13);
+	V tmp1 = add(tmp11, tmp12), tmp2 = sub(tmp11, tmp12);
+
+	// Odd part
+	V z13 = add(d[5], d[3]), z10 = sub(d[5], d[3]);
+	V z11 = add(d[1], d[7]), z12 = sub(d[1], d[7]);
+	V tmp7 = add(z11, z13);
+	tmp11 = mul(sub(z11, z13), 1.414213562f);
+	V z5 = mul(add(z10, z12), 1.847759065f);
+	tmp10 = sub(mul(z12, 1.082392200f), z5);
+	tmp12 = sub(z5, mul(z10, 2.613125930f));
+	V tmp6 = sub(tmp12, tmp7);
+	V tmp5 = sub(tmp11, tmp6);
+	V tmp4 = add(tmp10, tmp5);
+
+	d[0] = add(tmp0, tmp7);
+	d[7] = sub(tmp0, tmp7);
+	d[1] = add(tmp1, tmp6);
+	d[6] = sub(tmp1, tmp6);
+	d[2] = add(tmp2, tmp5);
+	d[5] = sub(tmp2, tmp5);
+	d[4] = add(tmp3, tmp4);
+	d[3] = sub(tmp3, tmp4);
+}
+
+#if defined(__AVX__)
+
+// Transposes the 8x8 block held by the rows r[0..7], in registers
+static inline void transpose_8x8(__m256 r[8]){
+	__m256 t0 = _mm256_unpacklo_ps(r[0], r[1]), t1 = _mm256_unpackhi_ps(r[0], r[1]);
+	__m256 t2 = _mm256_unpacklo_ps(r[2], r[3]), t3 = _mm256_unpackhi_ps(r[2], r[3]);
+	__m256 t4 = _mm256_unpacklo_ps(r[4], r[5]), t5 = _mm256_unpackhi_ps(r[4], r[5]);
+	__m256 t6 = _mm256_unpacklo_ps(r[6], r[7]), t7 = _mm256_unpackhi_ps(r[6], r[7]);
+	__m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)), s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)), s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0)), s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0)), s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+	r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+// Register r[k] holds row k: a butterfly across the registers transforms the 8 columns at once.
+// Transposing first makes it transform the rows, and transposing again brings the block back
+void aan_forward(float block[64], const aan_tables &tables){
+	__m256 r[8];
+	for(int k = 0; k < 8; k++)
+		r[k] = _mm256_loadu_ps(block + (k * 8));
+	transpose_8x8(r);
+	forward_butterfly(r);
+	transpose_8x8(r);
+	forward_butterfly(r);
+	for(int k = 0; k < 8; k++)
+		_mm256_storeu_ps(block + (k * 8), _mm256_mul_ps(r[k], _mm256_loadu_ps(tables.forward + (k * 8))));
+}
+
+void aan_inverse(float block[64], const aan_tables &tables){
+	__m256 r[8];
+	for(int k = 0; k < 8; k++)
+		r[k] = _mm256_mul_ps(_mm256_loadu_ps(block + (k * 8)), _mm256_loadu_ps(tables.inverse + (k * 8)));
+	transpose_8x8(r);
+	inverse_butterfly(r);
+	transpose_8x8(r);
+	inverse_butterfly(r);
+	for(int k = 0; k < 8; k++)
+		_mm256_storeu_ps(block + (k * 8), r[k]);
+}
+
+#else
+
+// Runs butterfly on the 8 values of every row (step 1, next 8) or every column (step 8, next 1)
+template<void (*butterfly)(float *)> static inline void pass(float block[64], int step, int next){
+	for(int k = 0; k < 8; k++)
+	{
+		float d[8];
+		for(int i = 0; i < 8; i++)
+			d[i] = block[(k * next) + (i * step)];
+		butterfly(d);
+		for(int i = 0; i < 8; i++)
+			block[(k * next) + (i * step)] = d[i];
+	}
+}
+
+void aan_forward(float block[64], const aan_tables &tables){
+	pass<forward_butterfly<float> >(block, 1, 8);
+	pass<forward_butterfly<float> >(block, 8, 1);
+	for(int i = 0; i < 64; i++)
+		block[i] *= tables.forward[i];
+}
+
+void aan_inverse(float block[64], const aan_tables &tables){
+	for(int i = 0; i < 64; i++)
+		block[i] *= tables.inverse[i];
+	pass<inverse_butterfly<float> >(block, 1, 8);
+	pass<inverse_butterfly<float> >(block, 8, 1);
+}
+
+#endif
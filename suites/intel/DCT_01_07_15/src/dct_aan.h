@@ -0,0 +1,53 @@
+//=======================================================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ======================================================================================
+// Fast 8x8 DCT and IDCT with the butterflies of Arai, Agui and Nakajima (AAN), the float
+// algorithm of the Independent JPEG Group library: 5 multiplications and 29 additions per
+// 8 values instead of 64 multiply-adds for a product with the DCT matrix.
+// The 2D transforms are a pass on the rows then a pass on the columns. The butterflies leave
+// every coefficient multiplied by a scale factor, which is folded into the quantization tables:
+// the forward transform gives the coefficients already divided by the quantization matrix, and
+// the inverse transform takes the quantized coefficients.
+// When built for Intel(R) AVX, the 8 rows of a block are 8 registers: one pass of butterflies
+// transforms the 8 columns at once, and the block is transposed in registers between the passes.
+#ifndef DCT_AAN_H
+#define DCT_AAN_H
+
+// Quantization matrix with the scale factors of the butterflies
+struct aan_tables {
+	float forward[64];	// 1 / (quantization * scale), multiplies the output of aan_forward
+	float inverse[64];	// quantization * scale, multiplies the input of aan_inverse
+};
+
+// Description:
+// Folds the scale factors of the butterflies into the quantization matrix quant (row major).
+//
+// [in]: quant
+// [out]: tables
+void create_aan_tables(const float quant[64], aan_tables &tables);
+
+// Description:
+// DCT of an 8x8 block of values centered on 0, divided by the quantization matrix: rounding
+// block[i] gives the quantized coefficients, row major (vertical frequency first).
+//
+// [in]: block, tables
+// [out]: block
+void aan_forward(float block[64], const aan_tables &tables);
+
+// Description:
+// IDCT of an 8x8 block of quantized coefficients: block[i] becomes the value of the pixel, centered on 0.
+//
+// [in]: block, tables
+// [out]: block
+void aan_inverse(float block[64], const aan_tables &tables);
+
+#endif // DCT_AAN_H
@@ -0,0 +1,207 @@
+//=======================================================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ======================================================================================
+#include "dct_islow.h"
+#include <emmintrin.h>
+
+// Fractional bits of the constants, and extra bits kept between the two passes
+#define CONST_BITS 13
+#define PASS1_BITS 2
+
+// The constants of the library, c * 2^13 rounded
+#define FIX_0_298631336 2446
+#define FIX_0_390180644 3196
+#define FIX_0_541196100 4433
+#define FIX_0_765366865 6270
+#define FIX_0_899976223 7373
+#define FIX_1_175875602 9633
+#define FIX_1_501321110 12299
+#define FIX_1_847759065 15137
+#define FIX_1_961570560 16069
+#define FIX_2_053119869 16819
+#define FIX_2_562915447 20995
+#define FIX_3_072711026 25172
+
+void create_islow_tables(const float quant[64], islow_tables &tables){
+	for(int i = 0; i < 64; i++)
+	{
+		tables.quantize[i] = 1.f / (8.f * quant[i]);
+		tables.dequantize[i] = (short)quant[i];
+	}
+}
+
+// 8 32 bit results, for the columns 0 to 3 and 4 to 7 of a row
+struct wide {
+	__m128i lo, hi;
+};
+
+static inline wide operator+(const wide &a, const wide &b){
+	wide r = { _mm_add_epi32(a.lo, b.lo), _mm_add_epi32(a.hi, b.hi) };
+	return r;
+}
+
+static inline wide operator-(const wide &a, const wide &b){
+	wide r = { _mm_sub_epi32(a.lo, b.lo), _mm_sub_epi32(a.hi, b.hi) };
+	return r;
+}
+
+// a * ca + b * cb in 32 bits, with one multiply-add of a and b interleaved
+static inline wide rotate(__m128i a, __m128i b, short ca, short cb){
+	const __m128i c = _mm_set_epi16(cb, ca, cb, ca, cb, ca, cb, ca);
+	wide r = { _mm_madd_epi16(_mm_unpacklo_epi16(a, b), c), _mm_madd_epi16(_mm_unpackhi_epi16(a, b), c) };
+	return r;
+}
+
+// a * ca + b * cb + c * cc + d * cd in 32 bits
+static inline wide rotate(__m128i a, __m128i b, __m128i c, __m128i d, short ca, short cb, short cc, short cd){
+	return rotate(a, b, ca, cb) + rotate(c, d, cc, cd);
+}
+
+// Divides by 2^n, rounding, and packs back to 16 bits
+template<int n> static inline __m128i descale(const wide &x){
+	const __m128i round = _mm_set1_epi32(1 << (n - 1));
+	return _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(x.lo, round), n), _mm_srai_epi32(_mm_add_epi32(x.hi, round), n));
+}
+
+// Odd part of both transforms, with the multiplications of the library expanded:
+// o[k] = t[0] * c[k][0] + ... + t[3] * c[k][3], which is exact in integers
+#define ODD_0 (FIX_0_298631336 - FIX_0_899976223 - FIX_1_961570560 + FIX_1_175875602), FIX_1_175875602, \
+	(FIX_1_175875602 - FIX_1_961570560), (FIX_1_175875602 - FIX_0_899976223)
+#define ODD_1 FIX_1_175875602, (FIX_2_053119869 - FIX_2_562915447 - FIX_0_390180644 + FIX_1_175875602), \
+	(FIX_1_175875602 - FIX_2_562915447), (FIX_1_175875602 - FIX_0_390180644)
+#define ODD_2 (FIX_1_175875602 - FIX_1_961570560), (FIX_1_175875602 - FIX_2_562915447), \
+	(FIX_3_072711026 - FIX_2_562915447 - FIX_1_961570560 + FIX_1_175875602), FIX_1_175875602
+#define ODD_3 (FIX_1_175875602 - FIX_0_899976223), (FIX_1_175875602 - FIX_0_390180644), \
+	FIX_1_175875602, (FIX_1_501321110 - FIX_0_899976223 - FIX_0_390180644 + FIX_1_175875602)
+
+// 8 point forward DCT of the 8 registers, in place. The first pass keeps PASS1_BITS more bits,
+// the second one removes them, so the output is the coefficients times 8
+template<int pass> static inline void forward_butterfly(__m128i d[8]){
+	__m128i tmp0 = _mm_add_epi16(d[0], d[7]), tmp7 = _mm_sub_epi16(d[0], d[7]);
+	__m128i tmp1 = _mm_add_epi16(d[1], d[6]), tmp6 = _mm_sub_epi16(d[1], d[6]);
+	__m128i tmp2 = _mm_add_epi16(d[2], d[5]), tmp5 = _mm_sub_epi16(d[2], d[5]);
+	__m128i tmp3 = _mm_add_epi16(d[3], d[4]), tmp4 = _mm_sub_epi16(d[3], d[4]);
+
+	// Even part
+	__m128i tmp10 = _mm_add_epi16(tmp0, tmp3), tmp13 = _mm_sub_epi16(tmp0, tmp3);
+	__m128i tmp11 = _mm_add_epi16(tmp1, tmp2), tmp12 = _mm_sub_epi16(tmp1, tmp2);
+	if(pass == 1)
+	{
+		d[0] = _mm_slli_epi16(_mm_add_epi16(tmp10, tmp11), PASS1_BITS);
+		d[4] = _mm_slli_epi16(_mm_sub_epi16(tmp10, tmp11), PASS1_BITS);
+	}
+	else
+	{
+		const __m128i round = _mm_set1_epi16(1 << (PASS1_BITS - 1));
+		d[0] = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(tmp10, tmp11), round), PASS1_BITS);
+		d[4] = _mm_srai_epi16(_mm_add_epi16(_mm_sub_epi16(tmp10, tmp11), round), PASS1_BITS);
+	}
+	const int bits = (pass == 1) ? CONST_BITS - PASS1_BITS : CONST_BITS + PASS1_BITS;
+	d[2] = descale<bits>(rotate(tmp13, tmp12, FIX_0_541196100 + FIX_0_765366865, FIX_0_541196100));
+	d[6] = descale<bits>(rotate(tmp13, tmp12, FIX_0_541196100, FIX_0_541196100 - FIX_1_847759065));
+
+	// Odd part
+	d[7] = descale<bits>(rotate(tmp4, tmp5, tmp6, tmp7, ODD_0));
+	d[5] = descale<bits>(rotate(tmp4, tmp5, tmp6, tmp7, ODD_1));
+	d[3] = descale<bits>(rotate(tmp4, tmp5, tmp6, tmp7, ODD_2));
+	d[1] = descale<bits>(rotate(tmp4, tmp5, tmp6, tmp7, ODD_3));
+}
+
+// 8 point inverse DCT of the 8 registers, in place. The first pass keeps PASS1_BITS more bits, the
+// second one removes them and the factor 8 of the coefficients
+template<int pass> static inline void inverse_butterfly(__m128i d[8]){
+	// Even part
+	wide tmp0 = rotate(d[0], d[4], 1 << CONST_BITS, 1 << CONST_BITS);
+	wide tmp1 = rotate(d[0], d[4], 1 << CONST_BITS, -(1 << CONST_BITS));
+	wide tmp2 = rotate(d[2], d[6], FIX_0_541196100, FIX_0_541196100 - FIX_1_847759065);
+	wide tmp3 = rotate(d[2], d[6], FIX_0_541196100 + FIX_0_765366865, FIX_0_541196100);
+	wide tmp10 = tmp0 + tmp3, tmp13 = tmp0 - tmp3;
+	wide tmp11 = tmp1 + tmp2, tmp12 = tmp1 - tmp2;
+
+	// Odd part, from the coefficients 7, 5, 3 and 1
+	wide odd0 = rotate(d[7], d[5], d[3], d[1], ODD_0);
+	wide odd1 = rotate(d[7], d[5], d[3], d[1], ODD_1);
+	wide odd2 = rotate(d[7], d[5], d[3], d[1], ODD_2);
+	wide odd3 = rotate(d[7], d[5], d[3], d[1], ODD_3);
+
+	const int bits = (pass == 1) ? CONST_BITS - PASS1_BITS : CONST_BITS + PASS1_BITS + 3;
+	d[0] = descale<bits>(tmp10 + odd3);
+	d[7] = descale<bits>(tmp10 - odd3);
+	d[1] = descale<bits>(tmp11 + odd2);
+	d[6] = descale<bits>(tmp11 - odd2);
+	d[2] = descale<bits>(tmp12 + odd1);
+	d[5] = descale<bits>(tmp12 - odd1);
+	d[3] = descale<bits>(tmp13 + odd0);
+	d[4] = descale<bits>(tmp13 - odd0);
+}
+
+// Transposes the 8x8 block of 16 bit values held by the rows r[0..7], in registers
+static inline void transpose_8x8(__m128i r[8]){
+	__m128i a0 = _mm_unpacklo_epi16(r[0], r[1]), a1 = _mm_unpackhi_epi16(r[0], r[1]);
+	__m128i a2 = _mm_unpacklo_epi16(r[2], r[3]), a3 = _mm_unpackhi_epi16(r[2], r[3]);
+	__m128i a4 = _mm_unpacklo_epi16(r[4], r[5]), a5 = _mm_unpackhi_epi16(r[4], r[5]);
+	__m128i a6 = _mm_unpacklo_epi16(r[6], r[7]), a7 = _mm_unpackhi_epi16(r[6], r[7]);
+	__m128i b0 = _mm_unpacklo_epi32(a0, a2), b1 = _mm_unpackhi_epi32(a0, a2);
+	__m128i b2 = _mm_unpacklo_epi32(a1, a3), b3 = _mm_unpackhi_epi32(a1, a3);
+	__m128i b4 = _mm_unpacklo_epi32(a4, a6), b5 = _mm_unpackhi_epi32(a4, a6);
+	__m128i b6 = _mm_unpacklo_epi32(a5, a7), b7 = _mm_unpackhi_epi32(a5, a7);
+	r[0] = _mm_unpacklo_epi64(b0, b4);
+	r[1] = _mm_unpackhi_epi64(b0, b4);
+	r[2] = _mm_unpacklo_epi64(b1, b5);
+	r[3] = _mm_unpackhi_epi64(b1, b5);
+	r[4] = _mm_unpacklo_epi64(b2, b6);
+	r[5] = _mm_unpackhi_epi64(b2, b6);
+	r[6] = _mm_unpacklo_epi64(b3, b7);
+	r[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+// Register r[k] holds row k: a butterfly across the registers transforms the 8 columns at once.
+// The library transforms the rows first, so the block is transposed first
+void islow_forward(short block[64]){
+	__m128i r[8];
+	for(int k = 0; k < 8; k++)
+		r[k] = _mm_loadu_si128((const __m128i *)(block + (k * 8)));
+	transpose_8x8(r);
+	forward_butterfly<1>(r);
+	transpose_8x8(r);
+	forward_butterfly<2>(r);
+	for(int k = 0; k < 8; k++)
+		_mm_storeu_si128((__m128i *)(block + (k * 8)), r[k]);
+}
+
+void islow_quantize(short block[64], const islow_tables &tables){
+	for(int k = 0; k < 8; k++)
+	{
+		__m128i row = _mm_loadu_si128((const __m128i *)(block + (k * 8)));
+		// Sign extension of the 16 bit values to 32 bits, then to floats
+		__m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(row, row), 16));
+		__m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(row, row), 16));
+		lo = _mm_mul_ps(lo, _mm_loadu_ps(tables.quantize + (k * 8)));
+		hi = _mm_mul_ps(hi, _mm_loadu_ps(tables.quantize + (k * 8) + 4));
+		// Conversion rounds to the nearest integer
+		_mm_storeu_si128((__m128i *)(block + (k * 8)), _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi)));
+	}
+}
+
+// The library transforms the columns first, so the block is transposed between the passes
+void islow_inverse(short block[64], const islow_tables &tables){
+	__m128i r[8];
+	for(int k = 0; k < 8; k++)
+		r[k] = _mm_mullo_epi16(_mm_loadu_si128((const __m128i *)(block + (k * 8))),
+							   _mm_loadu_si128((const __m128i *)(tables.dequantize + (k * 8))));
+	inverse_butterfly<1>(r);
+	transpose_8x8(r);
+	inverse_butterfly<2>(r);
+	transpose_8x8(r);
+	for(int k = 0; k < 8; k++)
+		_mm_storeu_si128((__m128i *)(block + (k * 8)), r[k]);
+}
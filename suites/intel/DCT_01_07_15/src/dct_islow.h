@@ -0,0 +1,61 @@
+//=======================================================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ======================================================================================
+// Integer 8x8 DCT and IDCT, the "islow" algorithm of the Independent JPEG Group library
+// (jfdctint.c and jidctint.c): the multiplications are by constants scaled by 2^13, and the
+// results are rounded back after every pass, so the arithmetic gives the same results as the
+// library. The values between the passes fit in 16 bits, the products and their sums in 32 bits.
+// With Intel(R) SSE2 a register holds the 8 16 bit values of a row of a block, twice as many as
+// with floats: one pass of butterflies transforms the 8 columns at once, the block is transposed
+// in registers between the passes, and every rotation is a multiply-add (pmaddwd) of two rows
+// interleaved.
+#ifndef DCT_ISLOW_H
+#define DCT_ISLOW_H
+
+// Quantization matrix of the integer versions
+struct islow_tables {
+	float quantize[64];	// 1 / (8 * quantization), as islow_forward gives the coefficients times 8
+	short dequantize[64];	// quantization
+};
+
+// Description:
+// Creates the tables of the integer versions from the quantization matrix quant (row major).
+//
+// [in]: quant
+// [out]: tables
+void create_islow_tables(const float quant[64], islow_tables &tables);
+
+// Description:
+// DCT of an 8x8 block of values centered on 0 (-128 to 127): block[i] becomes the coefficient
+// times 8, row major (vertical frequency first).
+//
+// [in]: block
+// [out]: block
+void islow_forward(short block[64]);
+
+// Description:
+// Quantization of the output of islow_forward: block[i] becomes the coefficient divided by the
+// quantization matrix, rounded to the nearest integer.
+//
+// [in]: block, tables
+// [out]: block
+void islow_quantize(short block[64], const islow_tables &tables);
+
+// Description:
+// Dequantization and IDCT of an 8x8 block of quantized coefficients: block[i] becomes the value of
+// the pixel, centered on 0 and not clamped.
+//
+// [in]: block, tables
+// [out]: block
+void islow_inverse(short block[64], const islow_tables &tables);
+
+#endif // DCT_ISLOW_H
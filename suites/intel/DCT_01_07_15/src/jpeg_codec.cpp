@@ -0,0 +1,1000 @@
+//=======================================================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ======================================================================================
+
+#include "jpeg_codec.h"
+#include "jpeg_tables.h"
+#include "dct_aan.h"
+#include "timer.h"
+
+#include <math.h>
+#include <string.h>
+#include <cilk/cilk.h>
+
+using namespace std;
+
+namespace jpeg {
+
+// Bits of the codes looked up at once by the Huffman decoder; longer codes are searched length by length
+#define HUFFMAN_LOOKAHEAD 9
+
+// Largest restart interval which fits in a DRI segment
+#define MAX_RESTART_INTERVAL 65535
+
+// Placement of the blocks of the three components. Every component is stored as a plane of bytes
+// padded to whole MCUs, the padding repeating the last row and column of the image. With 4:2:0
+// subsampling an MCU is 16x16 pixels: 4 luminance blocks, then one block of each chrominance plane.
+// Without it an MCU is 8x8 pixels, one block of each plane.
+struct Layout {
+	int width, height;
+	bool subsampled;
+	int mcu_size, mcus_x, mcus_y, blocks_per_mcu;
+	int luma_stride, luma_rows, chroma_stride, chroma_rows;
+
+	Layout(int w, int h, bool subsampling) : width(w), height(h), subsampled(subsampling){
+		mcu_size = subsampled ? 16 : 8;
+		mcus_x = (width + mcu_size - 1) / mcu_size;
+		mcus_y = (height + mcu_size - 1) / mcu_size;
+		blocks_per_mcu = subsampled ? 6 : 3;
+		luma_stride = mcus_x * mcu_size;
+		luma_rows = mcus_y * mcu_size;
+		chroma_stride = mcus_x * 8;
+		chroma_rows = mcus_y * 8;
+	}
+
+	// Component (0 luminance, 1 blue and 2 red chrominance) of block b of an MCU
+	int component(int b) const{
+		return subsampled ? ((b < 4) ? 0 : b - 3) : b;
+	}
+
+	// First byte of block b of MCU (mx, my) in the plane of its component
+	int block_offset(int mx, int my, int b) const{
+		if(subsampled && b < 4)
+		{
+			return (((my * 16) + ((b >> 1) * 8)) * luma_stride) + (mx * 16) + ((b & 1) * 8);
+		}
+		return (my * 8 * chroma_stride) + (mx * 8);
+	}
+
+	int stride(int b) const{
+		return (component(b) == 0) ? luma_stride : chroma_stride;
+	}
+
+	// Coefficients of the image, in the order they are coded: MCU after MCU, block after block
+	size_t coefficient_count() const{
+		return (size_t)mcus_x * mcus_y * blocks_per_mcu * 64;
+	}
+};
+
+static inline unsigned char clamp_byte(float value){
+	return (value <= 0.f) ? 0 : ((value >= 255.f) ? 255 : (unsigned char)value);
+}
+
+// Number of bits of the magnitude of value, its size category in the Huffman coding
+static inline int bit_length(int value){
+	if(value < 0)
+	{
+		value = -value;
+	}
+	int bits = 0;
+	while(value)
+	{
+		++bits;
+		value >>= 1;
+	}
+	return bits;
+}
+
+// Code and length of every symbol of a Huffman table, for the encoder
+struct HuffmanCode {
+	unsigned short code[256];
+	unsigned char size[256];
+
+	void create(const unsigned char bits[16], const unsigned char *values){
+		memset(size, 0, sizeof(size));
+		// Canonical codes: consecutive within a length, shifted left when the length grows (Annex C)
+		unsigned int next = 0;
+		int k = 0;
+		for(int length = 1; length <= 16; length++)
+		{
+			for(int i = 0; i < bits[length - 1]; i++, k++)
+			{
+				code[values[k]] = (unsigned short)next++;
+				size[values[k]] = (unsigned char)length;
+			}
+			next <<= 1;
+		}
+	}
+};
+
+// Huffman codes of the encoder, created once before main like the tables of DCT.cpp
+struct EncoderTables {
+	HuffmanCode dc[2], ac[2];
+
+	EncoderTables(){
+		dc[0].create(dc_luminance.bits, dc_luminance.values);
+		ac[0].create(ac_luminance.bits, ac_luminance.values);
+		dc[1].create(dc_chrominance.bits, dc_chrominance.values);
+		ac[1].create(ac_chrominance.bits, ac_chrominance.values);
+	}
+};
+static const EncoderTables encoder_tables;
+
+// Quantization tables of one quality, created once per image: the tables written to the file, and
+// their reciprocals with the scale factors of the butterflies, by which aan_forward multiplies
+struct QuantTables {
+	unsigned char table[2][64];
+	aan_tables aan[2];
+
+	QuantTables(int quality){
+		scale_quant_table(luminance_quant, quality, table[0]);
+		scale_quant_table(chrominance_quant, quality, table[1]);
+		for(int t = 0; t < 2; t++)
+		{
+			float quant[64];
+			for(int i = 0; i < 64; i++)
+			{
+				quant[i] = table[t][i];
+			}
+			create_aan_tables(quant, aan[t]);
+		}
+	}
+};
+
+// Writes codes of up to 16 bits MSB first, with a 0 byte stuffed after every 0xFF byte of data
+class BitWriter {
+public:
+	BitWriter(vector<unsigned char> &out) : m_out(out), m_bits(0), m_count(0) {}
+
+	void put(unsigned int code, int length){
+		m_bits = (m_bits << length) | (code & ((1u << length) - 1));
+		m_count += length;
+		while(m_count >= 8)
+		{
+			m_count -= 8;
+			unsigned char byte = (unsigned char)(m_bits >> m_count);
+			m_out.push_back(byte);
+			if(byte == 0xFF)
+			{
+				m_out.push_back(0);
+			}
+		}
+	}
+
+	// Completes the last byte with 1 bits, as required before a marker
+	void flush(){
+		if(m_count > 0)
+		{
+			put(0x7F, 8 - m_count);
+		}
+	}
+
+private:
+	vector<unsigned char> &m_out;
+	unsigned int m_bits;
+	int m_count;
+};
+
+// Description:
+// Huffman codes one block of quantized coefficients in zigzag order.
+//
+// [in]: coefficients, previous_dc (DC coefficient of the previous block of the component), dc, ac
+// [out]: writer, previous_dc
+static void encode_block(const short *coefficients, int &previous_dc, const HuffmanCode &dc,
+						 const HuffmanCode &ac, BitWriter &writer){
+	// The DC coefficient is coded as the difference with the previous one: the size category, then
+	// the low bits of the value, minus 1 if it is negative
+	int difference = coefficients[0] - previous_dc;
+	previous_dc = coefficients[0];
+	int size = bit_length(difference);
+	writer.put(dc.code[size], dc.size[size]);
+	if(size)
+	{
+		writer.put((difference < 0) ? difference - 1 : difference, size);
+	}
+	// Every other coefficient that is not 0 is coded with the run of 0 before it, in runs of up to
+	// 15 (ZRL codes 16 zeros), and the zeros at the end of the block with an end of block code
+	int run = 0;
+	for(int k = 1; k < 64; k++)
+	{
+		int value = coefficients[k];
+		if(value == 0)
+		{
+			++run;
+			continue;
+		}
+		while(run > 15)
+		{
+			writer.put(ac.code[0xF0], ac.size[0xF0]);
+			run -= 16;
+		}
+		size = bit_length(value);
+		int symbol = (run << 4) | size;
+		writer.put(ac.code[symbol], ac.size[symbol]);
+		writer.put((value < 0) ? value - 1 : value, size);
+		run = 0;
+	}
+	if(run > 0)
+	{
+		writer.put(ac.code[0x00], ac.size[0x00]);
+	}
+}
+
+// Description:
+// Converts the pixels of MCU row my to YCbCr (JFIF, full range), averaging the chrominance of
+// every 2x2 pixels when subsampled.
+//
+// [in]: pixels, layout, my
+// [out]: planes
+static void convert_mcu_row(const unsigned char *pixels, const Layout &layout, int my, unsigned char *planes[3]){
+	const int w = layout.width, h = layout.height;
+	for(int y = my * layout.mcu_size; y < (my + 1) * layout.mcu_size; y++)
+	{
+		// The BMP rows are stored bottom-up
+		const unsigned char *row = pixels + ((size_t)(h - 1 - ((y < h) ? y : h - 1)) * w * 3);
+		unsigned char *luma = planes[0] + ((size_t)y * layout.luma_stride);
+		for(int x = 0; x < layout.luma_stride; x++)
+		{
+			const unsigned char *pixel = row + (((x < w) ? x : w - 1) * 3);
+			float b = pixel[0], g = pixel[1], r = pixel[2];
+			luma[x] = clamp_byte((0.299f * r) + (0.587f * g) + (0.114f * b) + 0.5f);
+			if(!layout.subsampled)
+			{
+				planes[1][((size_t)y * layout.chroma_stride) + x] = clamp_byte((-0.168736f * r) - (0.331264f * g) + (0.5f * b) + 128.5f);
+				planes[2][((size_t)y * layout.chroma_stride) + x] = clamp_byte((0.5f * r) - (0.418688f * g) - (0.081312f * b) + 128.5f);
+			}
+		}
+	}
+	if(!layout.subsampled)
+	{
+		return;
+	}
+	for(int cy = my * 8; cy < (my + 1) * 8; cy++)
+	{
+		for(int cx = 0; cx < layout.chroma_stride; cx++)
+		{
+			float b = 0.f, g = 0.f, r = 0.f;
+			for(int dy = 0; dy < 2; dy++)
+			{
+				int y = (2 * cy) + dy;
+				const unsigned char *row = pixels + ((size_t)(h - 1 - ((y < h) ? y : h - 1)) * w * 3);
+				for(int dx = 0; dx < 2; dx++)
+				{
+					int x = (2 * cx) + dx;
+					const unsigned char *pixel = row + (((x < w) ? x : w - 1) * 3);
+					b += pixel[0];
+					g += pixel[1];
+					r += pixel[2];
+				}
+			}
+			planes[1][((size_t)cy * layout.chroma_stride) + cx] = clamp_byte(0.25f * ((-0.168736f * r) - (0.331264f * g) + (0.5f * b)) + 128.5f);
+			planes[2][((size_t)cy * layout.chroma_stride) + cx] = clamp_byte(0.25f * ((0.5f * r) - (0.418688f * g) - (0.081312f * b)) + 128.5f);
+		}
+	}
+}
+
+// Description:
+// DCT and quantization of the blocks of MCU row my, stored in zigzag order.
+//
+// [in]: planes, layout, my, quant
+// [out]: coefficients
+static void transform_mcu_row(unsigned char *const planes[3], const Layout &layout, int my,
+							  const QuantTables &quant, short *coefficients){
+	float block[64];
+	for(int mx = 0; mx < layout.mcus_x; mx++)
+	{
+		for(int b = 0; b < layout.blocks_per_mcu; b++)
+		{
+			int component = layout.component(b);
+			int stride = layout.stride(b);
+			const unsigned char *source = planes[component] + layout.block_offset(mx, my, b);
+			for(int i = 0; i < 8; i++)
+			{
+				for(int j = 0; j < 8; j++)
+				{
+					block[(i * 8) + j] = (float)source[(i * stride) + j] - 128.f;
+				}
+			}
+			aan_forward(block, quant.aan[(component == 0) ? 0 : 1]);
+			short *out = coefficients + ((((size_t)my * layout.mcus_x) + mx) * layout.blocks_per_mcu + b) * 64;
+			for(int k = 0; k < 64; k++)
+			{
+				// Baseline coding takes coefficients of up to 10 bits, and DC differences of up to 11 bits
+				float value = floorf(block[zigzag[k]] + 0.5f);
+				out[k] = (short)((value > 1023.f) ? 1023.f : ((value < -1023.f) ? -1023.f : value));
+			}
+		}
+	}
+}
+
+static void put_marker(vector<unsigned char> &out, unsigned char marker){
+	out.push_back(0xFF);
+	out.push_back(marker);
+}
+
+static void put_word(vector<unsigned char> &out, int value){
+	out.push_back((unsigned char)(value >> 8));
+	out.push_back((unsigned char)value);
+}
+
+static void put_huffman_table(vector<unsigned char> &out, int table_class, int id, const HuffmanSpec &spec){
+	put_marker(out, MARKER_DHT);
+	put_word(out, 2 + 1 + 16 + spec.count);
+	out.push_back((unsigned char)((table_class << 4) | id));
+	out.insert(out.end(), spec.bits, spec.bits + 16);
+	out.insert(out.end(), spec.values, spec.values + spec.count);
+}
+
+// Description:
+// Writes the markers and segments from the start of the image to the start of the scan.
+//
+// [in]: layout, quant, restart_interval (0 for no DRI segment)
+// [out]: out
+static void put_headers(vector<unsigned char> &out, const Layout &layout, const QuantTables &quant,
+						int restart_interval){
+	put_marker(out, MARKER_SOI);
+
+	// JFIF 1.1, no units, 1:1 aspect ratio, no thumbnail
+	static const unsigned char jfif[14] = { 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0 };
+	put_marker(out, MARKER_APP0);
+	put_word(out, 2 + sizeof(jfif));
+	out.insert(out.end(), jfif, jfif + sizeof(jfif));
+
+	// Quantization tables 0 (luminance) and 1 (chrominance), 8 bit, in zigzag order
+	put_marker(out, MARKER_DQT);
+	put_word(out, 2 + (2 * 65));
+	for(int t = 0; t < 2; t++)
+	{
+		out.push_back((unsigned char)t);
+		for(int k = 0; k < 64; k++)
+		{
+			out.push_back(quant.table[t][zigzag[k]]);
+		}
+	}
+
+	// Baseline frame: 8 bit samples, components 1 (Y), 2 (Cb) and 3 (Cr) with their sampling
+	// factors and quantization tables
+	put_marker(out, MARKER_SOF0);
+	put_word(out, 8 + (3 * 3));
+	out.push_back(8);
+	put_word(out, layout.height);
+	put_word(out, layout.width);
+	out.push_back(3);
+	for(int c = 0; c < 3; c++)
+	{
+		out.push_back((unsigned char)(c + 1));
+		out.push_back((c == 0 && layout.subsampled) ? 0x22 : 0x11);
+		out.push_back((c == 0) ? 0 : 1);
+	}
+
+	put_huffman_table(out, HUFFMAN_DC, 0, dc_luminance);
+	put_huffman_table(out, HUFFMAN_AC, 0, ac_luminance);
+	put_huffman_table(out, HUFFMAN_DC, 1, dc_chrominance);
+	put_huffman_table(out, HUFFMAN_AC, 1, ac_chrominance);
+
+	if(restart_interval > 0)
+	{
+		put_marker(out, MARKER_DRI);
+		put_word(out, 4);
+		put_word(out, restart_interval);
+	}
+
+	// One scan of the three components: Huffman tables 0 for luminance and 1 for chrominance, all
+	// 64 coefficients
+	put_marker(out, MARKER_SOS);
+	put_word(out, 6 + (2 * 3));
+	out.push_back(3);
+	for(int c = 0; c < 3; c++)
+	{
+		out.push_back((unsigned char)(c + 1));
+		out.push_back((c == 0) ? 0x00 : 0x11);
+	}
+	out.push_back(0);
+	out.push_back(63);
+	out.push_back(0);
+}
+
+bool encode(const unsigned char *pixels, int width, int height, const EncoderOptions &options,
+			vector<unsigned char> &jpeg, CodecStats *stats){
+	if(width <= 0 || height <= 0 || width > 65535 || height > 65535)
+	{
+		return false;
+	}
+	const Layout layout(width, height, options.subsampling == SUBSAMPLING_420);
+	CUtilTimer timer;
+
+	// Color conversion and subsampling
+	timer.start();
+	vector<unsigned char> luma((size_t)layout.luma_stride * layout.luma_rows);
+	vector<unsigned char> blue((size_t)layout.chroma_stride * layout.chroma_rows);
+	vector<unsigned char> red((size_t)layout.chroma_stride * layout.chroma_rows);
+	unsigned char *planes[3] = { &luma[0], &blue[0], &red[0] };
+	cilk_for(int my = 0; my < layout.mcus_y; my++)
+	{
+		convert_mcu_row(pixels, layout, my, planes);
+	}
+	timer.stop();
+	long long color_ticks = timer.get_ticks();
+
+	// DCT and quantization
+	timer.start();
+	const QuantTables quant(options.quality);
+	vector<short> coefficients(layout.coefficient_count());
+	cilk_for(int my = 0; my < layout.mcus_y; my++)
+	{
+		transform_mcu_row(planes, layout, my, quant, &coefficients[0]);
+	}
+	timer.stop();
+	long long transform_ticks = timer.get_ticks();
+
+	// Huffman coding of every restart interval into its own buffer, then the intervals joined in order
+	timer.start();
+	const int mcus = layout.mcus_x * layout.mcus_y;
+	int interval = (options.restart_interval > 0) ? options.restart_interval : layout.mcus_x;
+	if(interval > MAX_RESTART_INTERVAL)
+	{
+		interval = MAX_RESTART_INTERVAL;
+	}
+	const int intervals = (mcus + interval - 1) / interval;
+	vector<vector<unsigned char> > segments(intervals);
+	cilk_for(int s = 0; s < intervals; s++)
+	{
+		int first = s * interval;
+		int last = (first + interval < mcus) ? first + interval : mcus;
+		segments[s].reserve((size_t)(last - first) * layout.blocks_per_mcu * 16);
+		BitWriter writer(segments[s]);
+		int previous_dc[3] = { 0, 0, 0 };
+		for(int m = first; m < last; m++)
+		{
+			const short *mcu = &coefficients[(size_t)m * layout.blocks_per_mcu * 64];
+			for(int b = 0; b < layout.blocks_per_mcu; b++)
+			{
+				int component = layout.component(b);
+				int table = (component == 0) ? 0 : 1;
+				encode_block(mcu + (b * 64), previous_dc[component], encoder_tables.dc[table],
+							 encoder_tables.ac[table], writer);
+			}
+		}
+		writer.flush();
+	}
+	jpeg.clear();
+	put_headers(jpeg, layout, quant, (intervals > 1) ? interval : 0);
+	for(int s = 0; s < intervals; s++)
+	{
+		if(s > 0)
+		{
+			put_marker(jpeg, (unsigned char)(MARKER_RST0 + ((s - 1) & 7)));
+		}
+		jpeg.insert(jpeg.end(), segments[s].begin(), segments[s].end());
+	}
+	put_marker(jpeg, MARKER_EOI);
+	timer.stop();
+
+	if(stats)
+	{
+		stats->color_ticks = color_ticks;
+		stats->transform_ticks = transform_ticks;
+		stats->entropy_ticks = timer.get_ticks();
+		stats->intervals = intervals;
+	}
+	return true;
+}
+
+// Huffman table of the decoder. lookup gives, for the next HUFFMAN_LOOKAHEAD bits, the symbol and
+// the length << 8 of a code of up to that many bits, or -1. Longer codes are found from the largest
+// code of every length as in Annex F.2.2.3.
+struct HuffmanDecoder {
+	bool defined;
+	short lookup[1 << HUFFMAN_LOOKAHEAD];
+	int maxcode[17], mincode[17], valptr[17];
+	unsigned char values[256];
+
+	HuffmanDecoder() : defined(false) {}
+
+	bool create(const unsigned char bits[16], const unsigned char *symbols){
+		int count = 0;
+		for(int length = 1; length <= 16; length++)
+		{
+			count += bits[length - 1];
+		}
+		if(count > 256)
+		{
+			return false;
+		}
+		memcpy(values, symbols, count);
+		for(int i = 0; i < (1 << HUFFMAN_LOOKAHEAD); i++)
+		{
+			lookup[i] = -1;
+		}
+		int code = 0, k = 0;
+		for(int length = 1; length <= 16; length++)
+		{
+			// A table with more codes of a length than the length allows is invalid
+			if(code + bits[length - 1] > (1 << length))
+			{
+				return false;
+			}
+			valptr[length] = k;
+			mincode[length] = code;
+			for(int i = 0; i < bits[length - 1]; i++, k++, code++)
+			{
+				if(length <= HUFFMAN_LOOKAHEAD)
+				{
+					int shift = HUFFMAN_LOOKAHEAD - length;
+					for(int fill = 0; fill < (1 << shift); fill++)
+					{
+						lookup[(code << shift) | fill] = (short)((length << 8) | values[k]);
+					}
+				}
+			}
+			maxcode[length] = bits[length - 1] ? code - 1 : -1;
+			code <<= 1;
+		}
+		defined = true;
+		return true;
+	}
+};
+
+// Reads the entropy coded data of one restart interval, without its marker, removing the 0 bytes
+// stuffed after 0xFF. Past the end it reads 0 bits.
+class BitReader {
+public:
+	BitReader(const unsigned char *data, const unsigned char *end)
+		: m_data(data), m_end(end), m_bits(0), m_count(0) {}
+
+	// Next length (up to 16) bits, without consuming them
+	unsigned int peek(int length){
+		while(m_count <= 24)
+		{
+			unsigned int byte = 0;
+			if(m_data < m_end)
+			{
+				byte = *m_data++;
+				if(byte == 0xFF && m_data < m_end && *m_data == 0)
+				{
+					++m_data;
+				}
+			}
+			m_bits |= byte << (24 - m_count);
+			m_count += 8;
+		}
+		return m_bits >> (32 - length);
+	}
+
+	void skip(int length){
+		m_bits <<= length;
+		m_count -= length;
+	}
+
+	int get(int length){
+		if(length == 0)
+		{
+			return 0;
+		}
+		int value = (int)peek(length);
+		skip(length);
+		return value;
+	}
+
+	// Next Huffman symbol, or -1 if the bits are not a code of the table
+	int decode(const HuffmanDecoder &table){
+		int entry = table.lookup[peek(HUFFMAN_LOOKAHEAD)];
+		if(entry >= 0)
+		{
+			skip(entry >> 8);
+			return entry & 0xFF;
+		}
+		int bits = (int)peek(16);
+		for(int length = HUFFMAN_LOOKAHEAD + 1; length <= 16; length++)
+		{
+			int code = bits >> (16 - length);
+			if(code <= table.maxcode[length])
+			{
+				skip(length);
+				return table.values[table.valptr[length] + code - table.mincode[length]];
+			}
+		}
+		return -1;
+	}
+
+	// Value of size bits as coded by the encoder: from -(2^size - 1) to 2^size - 1 without 0
+	int receive(int size){
+		int value = get(size);
+		return (value < (1 << (size - 1))) ? value - (1 << size) + 1 : value;
+	}
+
+private:
+	const unsigned char *m_data;
+	const unsigned char *m_end;
+	unsigned int m_bits;
+	int m_count;
+};
+
+// Description:
+// Huffman decodes one block of coefficients in zigzag order. Returns false on a code not in the tables.
+//
+// [in]: reader, dc, ac, previous_dc
+// [out]: coefficients, previous_dc
+static bool decode_block(BitReader &reader, const HuffmanDecoder &dc, const HuffmanDecoder &ac,
+						 int &previous_dc, short *coefficients){
+	memset(coefficients, 0, 64 * sizeof(short));
+	int size = reader.decode(dc);
+	if(size < 0 || size > 11)
+	{
+		return false;
+	}
+	previous_dc += size ? reader.receive(size) : 0;
+	coefficients[0] = (short)previous_dc;
+	for(int k = 1; k < 64; k++)
+	{
+		int symbol = reader.decode(ac);
+		if(symbol < 0)
+		{
+			return false;
+		}
+		int run = symbol >> 4;
+		size = symbol & 15;
+		if(size == 0)
+		{
+			// End of block, or 16 zeros
+			if(run != 15)
+			{
+				break;
+			}
+			k += 15;
+			continue;
+		}
+		k += run;
+		if(k > 63)
+		{
+			return false;
+		}
+		coefficients[k] = (short)reader.receive(size);
+	}
+	return true;
+}
+
+// Description:
+// Dequantization and IDCT of the blocks of MCU row my into the planes.
+//
+// [in]: coefficients, layout, tables (per component)
+// [out]: planes
+static void inverse_mcu_row(const short *coefficients, const Layout &layout, int my,
+							const aan_tables *const tables[3], unsigned char *planes[3]){
+	float block[64];
+	for(int mx = 0; mx < layout.mcus_x; mx++)
+	{
+		for(int b = 0; b < layout.blocks_per_mcu; b++)
+		{
+			int component = layout.component(b);
+			const short *in = coefficients + ((((size_t)my * layout.mcus_x) + mx) * layout.blocks_per_mcu + b) * 64;
+			for(int k = 0; k < 64; k++)
+			{
+				block[zigzag[k]] = in[k];
+			}
+			aan_inverse(block, *tables[component]);
+			int stride = layout.stride(b);
+			unsigned char *target = planes[component] + layout.block_offset(mx, my, b);
+			for(int i = 0; i < 8; i++)
+			{
+				for(int j = 0; j < 8; j++)
+				{
+					target[(i * stride) + j] = clamp_byte(floorf(block[(i * 8) + j] + 128.5f));
+				}
+			}
+		}
+	}
+}
+
+// Description:
+// Converts the rows of MCU row my within the image from YCbCr to BGR, repeating every chrominance
+// sample over 2x2 pixels when subsampled.
+//
+// [in]: planes, layout, my
+// [out]: pixels
+static void convert_back_mcu_row(unsigned char *const planes[3], const Layout &layout, int my, unsigned char *pixels){
+	const int w = layout.width, h = layout.height;
+	const int shift = layout.subsampled ? 1 : 0;
+	int last = (my + 1) * layout.mcu_size;
+	if(last > h)
+	{
+		last = h;
+	}
+	for(int y = my * layout.mcu_size; y < last; y++)
+	{
+		const unsigned char *luma = planes[0] + ((size_t)y * layout.luma_stride);
+		const unsigned char *blue = planes[1] + ((size_t)(y >> shift) * layout.chroma_stride);
+		const unsigned char *red = planes[2] + ((size_t)(y >> shift) * layout.chroma_stride);
+		unsigned char *row = pixels + ((size_t)(h - 1 - y) * w * 3);
+		for(int x = 0; x < w; x++)
+		{
+			float Y = luma[x];
+			float cb = (float)blue[x >> shift] - 128.f;
+			float cr = (float)red[x >> shift] - 128.f;
+			row[(x * 3) + 0] = clamp_byte(Y + (1.772f * cb) + 0.5f);
+			row[(x * 3) + 1] = clamp_byte(Y - (0.344136f * cb) - (0.714136f * cr) + 0.5f);
+			row[(x * 3) + 2] = clamp_byte(Y + (1.402f * cr) + 0.5f);
+		}
+	}
+}
+
+static inline int read_word(const unsigned char *p){
+	return (p[0] << 8) | p[1];
+}
+
+bool decode(const unsigned char *jpeg, size_t size, vector<unsigned char> &pixels,
+			int &width, int &height, CodecStats *stats){
+	const unsigned char *p = jpeg;
+	const unsigned char *end = jpeg + size;
+	if(size < 4 || p[0] != 0xFF || p[1] != MARKER_SOI)
+	{
+		return false;
+	}
+	p += 2;
+
+	// Segments up to the start of the scan
+	float quant[4][64];
+	bool quant_defined[4] = { false, false, false, false };
+	HuffmanDecoder huffman[2][4];
+	int component_quant[3] = { 0, 0, 0 };
+	int component_dc[3] = { 0, 0, 0 }, component_ac[3] = { 0, 0, 0 };
+	int restart_interval = 0;
+	bool frame = false, subsampled = false;
+	width = height = 0;
+	for(;;)
+	{
+		if(end - p < 4 || p[0] != 0xFF)
+		{
+			return false;
+		}
+		unsigned char marker = p[1];
+		int length = read_word(p + 2);
+		const unsigned char *segment = p + 4;
+		if(length < 2 || end - p < 2 + length)
+		{
+			return false;
+		}
+		const unsigned char *segment_end = p + 2 + length;
+		p = segment_end;
+		if(marker == MARKER_DQT)
+		{
+			while(segment < segment_end)
+			{
+				int precision = segment[0] >> 4, id = segment[0] & 15;
+				if(precision != 0 || id > 3 || segment_end - segment < 65)
+				{
+					return false;
+				}
+				for(int k = 0; k < 64; k++)
+				{
+					quant[id][zigzag[k]] = segment[1 + k];
+				}
+				quant_defined[id] = true;
+				segment += 65;
+			}
+		}
+		else if(marker == MARKER_DHT)
+		{
+			while(segment < segment_end)
+			{
+				if(segment_end - segment < 17)
+				{
+					return false;
+				}
+				int table_class = segment[0] >> 4, id = segment[0] & 15;
+				int count = 0;
+				for(int l = 0; l < 16; l++)
+				{
+					count += segment[1 + l];
+				}
+				if(table_class > 1 || id > 3 || segment_end - segment < 17 + count
+					|| !huffman[table_class][id].create(segment + 1, segment + 17))
+				{
+					return false;
+				}
+				segment += 17 + count;
+			}
+		}
+		else if(marker == MARKER_SOF0)
+		{
+			// 8 bit samples and three components: Y at 2x2 or 1x1, Cb and Cr at 1x1
+			if(length != 8 + (3 * 3) || segment[0] != 8 || segment[5] != 3)
+			{
+				return false;
+			}
+			height = read_word(segment + 1);
+			width = read_word(segment + 3);
+			for(int c = 0; c < 3; c++)
+			{
+				const unsigned char *spec = segment + 6 + (c * 3);
+				if(spec[0] != c + 1 || spec[2] > 3)
+				{
+					return false;
+				}
+				if(c == 0)
+				{
+					if(spec[1] != 0x22 && spec[1] != 0x11)
+					{
+						return false;
+					}
+					subsampled = (spec[1] == 0x22);
+				}
+				else if(spec[1] != 0x11)
+				{
+					return false;
+				}
+				component_quant[c] = spec[2];
+			}
+			frame = true;
+		}
+		else if(marker == MARKER_DRI)
+		{
+			if(length != 4)
+			{
+				return false;
+			}
+			restart_interval = read_word(segment);
+		}
+		else if(marker == MARKER_SOS)
+		{
+			if(length != 6 + (2 * 3) || segment[0] != 3)
+			{
+				return false;
+			}
+			for(int c = 0; c < 3; c++)
+			{
+				if(segment[1 + (c * 2)] != c + 1)
+				{
+					return false;
+				}
+				component_dc[c] = segment[2 + (c * 2)] >> 4;
+				component_ac[c] = segment[2 + (c * 2)] & 15;
+			}
+			if(segment[7] != 0 || segment[8] != 63 || segment[9] != 0)
+			{
+				return false;
+			}
+			break;
+		}
+		else if((marker >= 0xC1 && marker <= 0xCF && marker != MARKER_DHT) || marker == MARKER_EOI)
+		{
+			// Other frame types (progressive, arithmetic coding...) are not supported
+			return false;
+		}
+		// APPn, COM and other segments are skipped
+	}
+	if(!frame || width == 0 || height == 0)
+	{
+		return false;
+	}
+	for(int c = 0; c < 3; c++)
+	{
+		if(!quant_defined[component_quant[c]] || component_dc[c] > 3 || component_ac[c] > 3
+			|| !huffman[HUFFMAN_DC][component_dc[c]].defined || !huffman[HUFFMAN_AC][component_ac[c]].defined)
+		{
+			return false;
+		}
+	}
+	const Layout layout(width, height, subsampled);
+	const int mcus = layout.mcus_x * layout.mcus_y;
+	const int interval = (restart_interval > 0) ? restart_interval : mcus;
+	const int intervals = (mcus + interval - 1) / interval;
+	CUtilTimer timer;
+
+	// Entropy coded data of every restart interval, between the restart markers
+	timer.start();
+	vector<const unsigned char *> starts, ends;
+	starts.push_back(p);
+	for(const unsigned char *q = p; ; )
+	{
+		if(q + 1 >= end)
+		{
+			ends.push_back(end);
+			break;
+		}
+		if(q[0] != 0xFF || q[1] == 0)
+		{
+			q += (q[0] == 0xFF) ? 2 : 1;
+			continue;
+		}
+		// A marker, possibly after 0xFF fill bytes
+		const unsigned char *data_end = q;
+		while(q + 1 < end && q[1] == 0xFF)
+		{
+			++q;
+		}
+		ends.push_back(data_end);
+		if(q + 1 >= end || q[1] < MARKER_RST0 || q[1] > MARKER_RST0 + 7)
+		{
+			break;
+		}
+		q += 2;
+		starts.push_back(q);
+	}
+	if((int)starts.size() < intervals)
+	{
+		return false;
+	}
+	vector<short> coefficients(layout.coefficient_count());
+	vector<char> good(intervals);
+	cilk_for(int s = 0; s < intervals; s++)
+	{
+		int first = s * interval;
+		int last = (first + interval < mcus) ? first + interval : mcus;
+		BitReader reader(starts[s], ends[s]);
+		int previous_dc[3] = { 0, 0, 0 };
+		good[s] = 1;
+		for(int m = first; m < last && good[s]; m++)
+		{
+			short *mcu = &coefficients[(size_t)m * layout.blocks_per_mcu * 64];
+			for(int b = 0; b < layout.blocks_per_mcu; b++)
+			{
+				int component = layout.component(b);
+				if(!decode_block(reader, huffman[HUFFMAN_DC][component_dc[component]],
+								 huffman[HUFFMAN_AC][component_ac[component]], previous_dc[component], mcu + (b * 64)))
+				{
+					good[s] = 0;
+					break;
+				}
+			}
+		}
+	}
+	timer.stop();
+	long long entropy_ticks = timer.get_ticks();
+	for(int s = 0; s < intervals; s++)
+	{
+		if(!good[s])
+		{
+			return false;
+		}
+	}
+
+	// Dequantization and IDCT
+	timer.start();
+	aan_tables component_tables[3];
+	const aan_tables *tables[3];
+	for(int c = 0; c < 3; c++)
+	{
+		create_aan_tables(quant[component_quant[c]], component_tables[c]);
+		tables[c] = &component_tables[c];
+	}
+	vector<unsigned char> luma((size_t)layout.luma_stride * layout.luma_rows);
+	vector<unsigned char> blue((size_t)layout.chroma_stride * layout.chroma_rows);
+	vector<unsigned char> red((size_t)layout.chroma_stride * layout.chroma_rows);
+	unsigned char *planes[3] = { &luma[0], &blue[0], &red[0] };
+	cilk_for(int my = 0; my < layout.mcus_y; my++)
+	{
+		inverse_mcu_row(&coefficients[0], layout, my, tables, planes);
+	}
+	timer.stop();
+	long long transform_ticks = timer.get_ticks();
+
+	// Color conversion and upsampling
+	timer.start();
+	pixels.resize((size_t)width * height * 3);
+	cilk_for(int my = 0; my < layout.mcus_y; my++)
+	{
+		convert_back_mcu_row(planes, layout, my, &pixels[0]);
+	}
+	timer.stop();
+
+	if(stats)
+	{
+		stats->color_ticks = timer.get_ticks();
+		stats->transform_ticks = transform_ticks;
+		stats->entropy_ticks = entropy_ticks;
+		stats->intervals = intervals;
+	}
+	return true;
+}
+
+} // namespace jpeg
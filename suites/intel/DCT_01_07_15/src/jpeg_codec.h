@@ -0,0 +1,75 @@
+//=======================================================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ======================================================================================
+// Baseline JPEG (JFIF) encoder built on the DCT of the sample, and the decoder of the files it writes.
+// The encoder runs in three stages, each one parallel with cilk_for:
+//   1. color conversion to YCbCr and chroma subsampling, one row of MCUs at a time
+//      (an MCU, minimum coded unit, is the 8x8 blocks of every component covering the same pixels),
+//   2. AAN DCT and quantization of every block, one row of MCUs at a time,
+//   3. zigzag ordering and Huffman coding with the standard tables of the JPEG specification.
+// Huffman coding is serial within a run of MCUs, since every block is coded relative to the DC
+// coefficient of the block before it and ends at any bit position. Restart markers cut the image
+// into intervals which start from a fresh DC prediction on a byte boundary, so every interval is
+// coded on its own in parallel and the intervals are then joined, separated by the markers.
+// The decoder splits the data at the restart markers in the same way.
+
+#ifndef JPEG_CODEC_H
+#define JPEG_CODEC_H
+
+#include <stddef.h>
+#include <vector>
+
+namespace jpeg {
+
+enum Subsampling {
+	SUBSAMPLING_444,	// full resolution chroma
+	SUBSAMPLING_420		// chroma averaged over 2x2 pixels
+};
+
+struct EncoderOptions {
+	Subsampling subsampling;
+	// MCUs in a restart interval, 0 for one row of MCUs per interval
+	int restart_interval;
+	// 1 to 100, scaling the example quantization tables of the JPEG specification as libjpeg does
+	int quality;
+	EncoderOptions() : subsampling(SUBSAMPLING_420), restart_interval(0), quality(75) {}
+};
+
+// Clock ticks spent in each stage of an encode or a decode
+struct CodecStats {
+	long long color_ticks;		// color conversion and subsampling, or the inverse
+	long long transform_ticks;	// DCT and quantization, or dequantization and IDCT
+	long long entropy_ticks;	// Huffman coding or decoding
+	int intervals;				// restart intervals
+};
+
+// Description:
+// Encodes a packed 24 bit image, stored bottom-up as in a BMP file, to a JFIF file in memory.
+// Returns false if the image is empty or wider or higher than 65535 pixels.
+//
+// [in]: pixels (width * height * 3 bytes, blue, green, red), width, height, options
+// [out]: jpeg, stats (may be NULL)
+bool encode(const unsigned char *pixels, int width, int height, const EncoderOptions &options,
+			std::vector<unsigned char> &jpeg, CodecStats *stats);
+
+// Description:
+// Decodes a baseline JPEG file with 3 components, as written by encode, to a packed 24 bit image
+// stored bottom-up. Returns false if the file is not such a JPEG file or is truncated.
+//
+// [in]: jpeg, size
+// [out]: pixels, width, height, stats (may be NULL)
+bool decode(const unsigned char *jpeg, size_t size, std::vector<unsigned char> &pixels,
+			int &width, int &height, CodecStats *stats);
+
+} // namespace jpeg
+
+#endif // JPEG_CODEC_H
@@ -0,0 +1,63 @@
+//=======================================================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ======================================================================================
+// Tables and markers shared by the JPEG encoder and decoder, from the JPEG specification
+// (ITU-T T.81): the zigzag order, the example quantization tables of Annex K.1 and the
+// Huffman tables of Annex K.3.
+
+#ifndef JPEG_TABLES_H
+#define JPEG_TABLES_H
+
+namespace jpeg {
+
+// Markers, written after a 0xFF byte
+const unsigned char MARKER_SOI = 0xD8;	// start of image
+const unsigned char MARKER_EOI = 0xD9;	// end of image
+const unsigned char MARKER_APP0 = 0xE0;	// JFIF header
+const unsigned char MARKER_DQT = 0xDB;	// quantization tables
+const unsigned char MARKER_SOF0 = 0xC0;	// baseline frame header
+const unsigned char MARKER_DHT = 0xC4;	// Huffman tables
+const unsigned char MARKER_DRI = 0xDD;	// restart interval
+const unsigned char MARKER_SOS = 0xDA;	// start of scan
+const unsigned char MARKER_RST0 = 0xD0;	// restart markers RST0 to RST7, used in turn
+
+// Position in the 8x8 block, row major, of the k-th coefficient in zigzag order
+extern const unsigned char zigzag[64];
+
+// Example quantization tables for luminance and chrominance, row major
+extern const unsigned char luminance_quant[64];
+extern const unsigned char chrominance_quant[64];
+
+// Description:
+// Scales a quantization table to quality, from 1 to 100, as the Independent JPEG Group library
+// does: 50 keeps the table, lower qualities multiply it by 50 / quality and higher qualities by
+// 2 - quality / 50. The values are rounded and kept from 1 to 255, as baseline files store them
+// in 8 bits.
+//
+// [in]: base, quality
+// [out]: table
+void scale_quant_table(const unsigned char base[64], int quality, unsigned char table[64]);
+
+// Huffman table as stored in a DHT segment: bits[l] codes of length l + 1, then the symbols by code
+struct HuffmanSpec {
+	unsigned char bits[16];
+	const unsigned char *values;
+	int count;
+};
+
+// Table classes, the first digit of Tc/Th in a DHT segment
+enum { HUFFMAN_DC = 0, HUFFMAN_AC = 1 };
+extern const HuffmanSpec dc_luminance, ac_luminance, dc_chrominance, ac_chrominance;
+
+} // namespace jpeg
+
+#endif // JPEG_TABLES_H
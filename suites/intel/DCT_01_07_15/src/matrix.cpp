@@ -169,6 +169,79 @@
 	}
 
 
+	 matrix_8x8 matrix_8x8::operator*(const matrix_8x8 &y) const{
+		matrix_8x8 temp;
+		for(int i = 0; i < 8; i++)
+		{
+			for(int j = 0; j < 8; j++)
+			{
+				temp.ptr[(i * 8) + j] = 0;
+				for(int k = 0; k < 8; k++)
+					temp.ptr[(i * 8) + j] += (ptr[(i * 8) + k] * y.ptr[(k * 8) + j]);
+			}
+		}
+		return temp;
+	}
+	 void matrix_8x8::transpose(matrix_8x8 &output) const{
+		for(int i = 0; i < 8; i++)
+		{
+			for(int j = 0; j < 8; j++)
+				output.ptr[(j * 8) + i] = ptr[(i * 8) + j];
+		}
+		return;
+	}
+	 //Row i of the products is the sum over k of element (i, k) of the left matrix times row k of the
+	 //right matrix. A row of 8 floats is one Intel(R) AVX register, or two SSE registers
+#if defined(__AVX__)
+	 typedef __m256 row_8;
+	 static inline row_8 broadcast(float x) { return _mm256_set1_ps(x); }
+	 static inline row_8 load_row(const float *p) { return _mm256_loadu_ps(p); }
+	 static inline void store_row(float *p, row_8 r) { _mm256_storeu_ps(p, r); }
+	 static inline row_8 multiply_add(row_8 sum, row_8 factor, row_8 row) { return _mm256_add_ps(sum, _mm256_mul_ps(factor, row)); }
+	 static inline row_8 zero_row() { return _mm256_setzero_ps(); }
+#else
+	 struct row_8 { __m128 lo, hi; };
+	 static inline row_8 broadcast(float x) { row_8 r = {_mm_set1_ps(x), _mm_set1_ps(x)}; return r; }
+	 static inline row_8 load_row(const float *p) { row_8 r = {_mm_loadu_ps(p), _mm_loadu_ps(p + 4)}; return r; }
+	 static inline void store_row(float *p, row_8 r) { _mm_storeu_ps(p, r.lo); _mm_storeu_ps(p + 4, r.hi); }
+	 static inline row_8 multiply_add(row_8 sum, row_8 factor, row_8 row) {
+		row_8 r = {_mm_add_ps(sum.lo, _mm_mul_ps(factor.lo, row.lo)), _mm_add_ps(sum.hi, _mm_mul_ps(factor.hi, row.hi))};
+		return r;
+	 }
+	 static inline row_8 zero_row() { row_8 r = {_mm_setzero_ps(), _mm_setzero_ps()}; return r; }
+#endif
+	 void multiply_left(const matrix_8x8 &a, const matrix_8x8 x[3], matrix_8x8 output[3]){
+		for(int i = 0; i < 8; i++)
+		{
+			row_8 sum[3] = {zero_row(), zero_row(), zero_row()};
+			for(int k = 0; k < 8; k++)
+			{
+				row_8 factor = broadcast(a.ptr[(i * 8) + k]);
+				for(int c = 0; c < 3; c++)
+					sum[c] = multiply_add(sum[c], factor, load_row(&x[c].ptr[k * 8]));
+			}
+			for(int c = 0; c < 3; c++)
+				store_row(&output[c].ptr[i * 8], sum[c]);
+		}
+		return;
+	}
+	 void multiply_right(const matrix_8x8 x[3], const matrix_8x8 &b, matrix_8x8 output[3]){
+		for(int i = 0; i < 8; i++)
+		{
+			row_8 sum[3] = {zero_row(), zero_row(), zero_row()};
+			for(int k = 0; k < 8; k++)
+			{
+				row_8 row = load_row(&b.ptr[k * 8]);
+				for(int c = 0; c < 3; c++)
+					sum[c] = multiply_add(sum[c], broadcast(x[c].ptr[(i * 8) + k]), row);
+			}
+			for(int c = 0; c < 3; c++)
+				store_row(&output[c].ptr[i * 8], sum[c]);
+		}
+		return;
+	}
+
+
 /*	 ostream& operator<<(ostream &out, matrix_serial &x){
 		for(int i = 0; i < x.row_size; i++)
 		{
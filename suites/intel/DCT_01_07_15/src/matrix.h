@@ -1,6 +1,9 @@
 #define ALIGNMENT 32 //Set to 16 bytes for SSE architectures and 32 bytes for AVX architectures
 #include<iostream>
 #include<xmmintrin.h>
+#if defined(__AVX__)
+#include<immintrin.h>
+#endif
 #include<string.h>
 using namespace std;
 class matrix_serial {
@@ -18,6 +21,21 @@ public:
 	 //friend ostream& operator<<(ostream &, matrix_serial &);
 };
 
+// 8x8 matrix of floats held by value, for the blocks of the DCT: the blocks and the products, which are
+// returned by value, live on the stack, so transforming a block does not allocate any memory
+struct matrix_8x8 {
+	float ptr[64];
+	matrix_8x8 operator*(const matrix_8x8 &) const;
+	void transpose(matrix_8x8 &) const;
+};
+
+// Products of the 3 matrices x[0..2] of the channels of a block with the same matrix, on the left
+// (output[c] = a * x[c]) or on the right (output[c] = x[c] * b). Every element of the shared matrix
+// is read once for the three channels, and the sums are done in the same order as operator*, so
+// the products are the same.
+void multiply_left(const matrix_8x8 &a, const matrix_8x8 x[3], matrix_8x8 output[3]);
+void multiply_right(const matrix_8x8 x[3], const matrix_8x8 &b, matrix_8x8 output[3]);
+
 #ifdef __INTEL_COMPILER
 class matrix_AN {
 public:
@@ -17,6 +17,8 @@
 // To learn more how this is laid out, check http://en.wikipedia.org/wiki/BMP_file_format
 
 #include "bmp_image.h"
+#include "bmp_io.h"
+#include "valsig.h"
 
 #ifndef _USE_MATH_DEFINES
     #define _USE_MATH_DEFINES
@@ -30,6 +32,7 @@
 #include <istream>
 #include <cmath>
 #include <memory.h>
+#include <vector>
 
 using namespace io;
 
@@ -94,14 +97,13 @@ unsigned int BMPImage::channels() const {
 /// If @p filename cannot be opened, this routine attempts to load @p failover_file instead.
 /// Typically @p failover_file is copied to the directory with the executable after it is built.
 bool BMPImage::load(const std::string& filename, const std::string& failover_file) {
-    std::ifstream file;
+    bmpio::MappedBMP file;
 
     clear();
-    file.open(filename.c_str(), std::ios::binary);
+    file.open(filename.c_str());
 
     if (!failover_file.empty() && !file.is_open()) {
-        file.clear();
-        file.open(failover_file.c_str(), std::ios::binary);
+        file.open(failover_file.c_str());
 
         /// If the failover file exists...
         if (file.is_open()) {
@@ -119,6 +121,7 @@ bool BMPImage::load(const std::string& filename, const std::string& failover_fil
         }
     }
 
+    /// MappedBMP::open also fails on files which are not uncompressed BMP images
     if (!file.is_open()) {
         std::ostringstream message;
         message << "File '" << filename << "' not found!";
@@ -127,19 +130,12 @@ bool BMPImage::load(const std::string& filename, const std::string& failover_fil
             message << std::endl << "--> Please check the relative path from the current directory to the specified image file.";
         }
         //throw io::exception(message.str());
+        return false;
     }
 
-    /// Process the header
-    file.read((char*)&m_file_header, sizeof(BitmapFileHeader));
-    if (!file.good() || m_file_header.type != 0x4d42) {
-        file.close();
-        //throw io::exception("Invalid format for a BMP file!");
-    }
-    file.read((char*)&m_info_header, sizeof(BitmapInfoHeader));
-    if (!file.good()) {
-        file.close();
-        //throw io::exception("Invalid format for a BMP file!");
-    }
+    /// Process the header, read in place from the mapping
+    memcpy(&m_file_header, file.header(), sizeof(BitmapFileHeader));
+    memcpy(&m_info_header, file.header() + sizeof(BitmapFileHeader), sizeof(BitmapInfoHeader));
 
     m_width = m_info_header.width;
     m_height = m_info_header.height;
@@ -148,155 +144,51 @@ bool BMPImage::load(const std::string& filename, const std::string& failover_fil
     m_image_size = m_width * m_height * channels();
     m_image = new unsigned char[m_image_size];
 
-    const unsigned int row_size = static_cast<unsigned int>(ceil(double(m_bpp * m_width) / 32.0)) * 4;
-
-    if (row_size == m_width * channels()) {
-        file.read(reinterpret_cast<char*>(m_image), m_image_size);
-    }
-    else {
-        /// Remove padding
-        char* temp = new char[row_size * m_height];
-        file.read(temp, row_size * m_height);
-
-        for (unsigned int y = 0; y < m_height; ++y) {
-            for (unsigned int x = 0; x < m_width; ++x) {
-                for (unsigned int c = 0; c < channels(); ++c) {
-                    m_image[c + x * channels() + y * m_width * channels()] = static_cast<unsigned char>(temp[c + x * channels() + y * row_size]);
-                }
-            }
-        }
-        delete[] temp;
-    }
-
-    if (!file.good()) {
-        file.close();
-        //throw io::exception("Invalid format for a BMP file!");
-    }
-
-    file.close();
+    /// The padding is removed while the rows are copied out of the mapping
+    file.copy_pixels(m_image);
     return true;
  }
 
 
 bool BMPImage::valsig(const std::string& filename) const {
-    std::ofstream file;
-    file.open(filename.c_str(), std::ios::trunc);
-
-    if (!file.good()) {
-        //throw io::exception("Error creating a VALSIG file!");
-        return false;
-    }
-
-    if (m_width > 0 && m_height > 0) {
-        const unsigned int chan = channels();
-        const unsigned int max_chan = 3;
-        assert( chan <= max_chan );
-        unsigned (*colsum)[max_chan] = new unsigned[m_width][max_chan];
-        memset( colsum, 0, m_width*max_chan*sizeof(unsigned) );
-        for( int d=0; d<1; ++d ) {
-            file << "Frame " << d << " rows" << std::endl;
-            for( unsigned int y=0; y<m_height; ++y ) {
-                unsigned rowsum[max_chan];
-                memset( rowsum, 0, max_chan*sizeof(unsigned) );
-                for( unsigned int x=0; x<m_width; ++x ) {
-                    for( unsigned int k=0; k<chan; ++k ) {
-                        unsigned char v = static_cast<unsigned char>(m_image[k + x * chan + y * m_width * chan]);
-                        rowsum[k] += v;
-                        colsum[x][k] += v;
-                    }
-                }
-                file << rowsum[0];
-                for ( int k = 1; k < max_chan; ++k)
-                    file << " " << rowsum[k];
-                file << std::endl; 
-            }
-            file << "Frame " << d << " columns" << std::endl;
-            for( unsigned int x=0; x<m_width; ++x ) {
-                file << colsum[x][0];
-                for ( int k = 1; k < max_chan; ++k)
-                    file << " " << colsum[x][k];
-                file << std::endl; 
-            }
-        }
-        delete[] colsum;
-    }
-
-    if (!file.good()) {
-        file.close();
+    ValidationSignature signature;
+    signature.compute(m_image, m_width, m_height, channels());
+    if (!signature.save(filename)) {
         //throw io::exception("Error writing image data for a VALSIG file!");
         return false;
     }
-
-    file.close();
     return true;
 }
 
+bool BMPImage::valsig(const std::string& filename, const std::string& digest_filename) const {
+    ValidationSignature signature;
+    signature.compute(m_image, m_width, m_height, channels());
+    return signature.save(filename) && signature.save_digest(digest_filename);
+}
+
 
 bool BMPImage::save(const std::string& filename) const
 {
-    std::ofstream file;
-    file.open(filename.c_str(),std::ios::binary | std::ios::trunc);
-
-    if (!file.good()) {
-        //throw io::exception("Error creating a BMP file!");
-        return false;
-    }
-
-    file.write(reinterpret_cast<const char*>(&m_file_header), sizeof(BitmapFileHeader));
-    if (!file.good()) {
-        file.close();
-        //throw io::exception("Error writing the file header for a BMP file!");
-        return false;
-    }
-
-    file.write(reinterpret_cast<const char*>(&m_info_header), sizeof(BitmapInfoHeader));
-    if (!file.good()) {
-        file.close();
-        //throw io::exception("Error writing the info header for a BMP file!");
-        return false;
-    }
-
+    /// Everything before the pixels: both headers, and the color table for bpp <= 8
+    std::vector<unsigned char> header(m_file_header.offsetbits, 0);
+    memcpy(&header[0], &m_file_header, sizeof(BitmapFileHeader));
+    memcpy(&header[sizeof(BitmapFileHeader)], &m_info_header, sizeof(BitmapInfoHeader));
 
     if (m_bpp <= 8) {
         int color_table_size = int(pow(2.0, double(m_bpp)));
-        BitmapRGBQuad m_color_table[256];
+        BitmapRGBQuad* color_table = reinterpret_cast<BitmapRGBQuad*>(&header[sizeof(BitmapFileHeader) + sizeof(BitmapInfoHeader)]);
         for (int i = 0; i < color_table_size; ++i) {
-            m_color_table[i].red = i;
-            m_color_table[i].green = i;
-            m_color_table[i].blue = i;
-            m_color_table[i].reserved = 0;
-        }
-        file.write(reinterpret_cast<const char*>(m_color_table), sizeof(m_color_table));
-        if (!file.good()) {
-            file.close();
-            //throw io::exception("Error writing the color table for a BMP file!");
-            return false;
-        }
-    }
-    if (m_info_header.sizeimage == m_image_size) {
-        file.write((const char*)m_image, m_image_size);
-    }
-    else {
-        /// Padding row size to a multiple of 4 bytes
-        unsigned int row_size = static_cast<unsigned int>(ceil(double(m_bpp * m_width) / 32.0)) * 4;
-        char* temp = new char[m_info_header.sizeimage];
-        memset(temp, 0, m_info_header.sizeimage);
-        for (unsigned int y = 0; y < m_height; ++y) {
-            for (unsigned int x = 0; x < m_width; ++x) {
-                for (unsigned int c = 0; c < channels(); ++c) {
-                    temp[c + x * channels() + y * row_size] = static_cast<char>(m_image[c + x * channels() + y * m_width * channels()]);
-                }
-            }
+            color_table[i].red = i;
+            color_table[i].green = i;
+            color_table[i].blue = i;
+            color_table[i].reserved = 0;
         }
-        file.write(temp, m_info_header.sizeimage);
-        delete[] temp;
     }
-    if (!file.good()) {
-        file.close();
+
+    /// Rows are padded to a multiple of 4 bytes while they are written
+    if (!bmpio::write_bmp(filename.c_str(), &header[0], header.size(), m_image, m_width, m_height, m_bpp)) {
         //throw io::exception("Error writing image data for a BMP file!");
         return false;
     }
-
-    file.close();
     return true;
 }
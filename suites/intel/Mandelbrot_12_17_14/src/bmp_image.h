@@ -64,6 +64,8 @@ public:
     bool save(const std::string& filename) const;
     // Save a validation signature, which is linear in width+heigh.
     bool valsig(const std::string& filename) const;
+    // Save the signature both as text and as a one line hex digest, computing it once
+    bool valsig(const std::string& filename, const std::string& digest_filename) const;
     virtual void clear();
     virtual unsigned int channels() const;
 
@@ -19,8 +19,12 @@
 
 #include <string>
 #include <cassert>
+#include <cstring>
+#include <algorithm>
 #include <exception>
 
+#include <cilk/cilk.h>
+
 namespace io {
 
 class exception : public std::exception {
@@ -36,16 +40,30 @@ private:
     std::string m_message;
 };
 
+template<typename A, typename B>
+struct same_type {
+    static const bool value = false;
+};
+
+template<typename A>
+struct same_type<A, A> {
+    static const bool value = true;
+};
+
 template<typename T>
 class ImageBase {
 public:
     ImageBase():
     m_image(0),
+    m_owns_image(true),
     m_width(0),
     m_height(0),
     m_bpp(0),
     m_image_size(0)
     {}
+    /// Virtual, since the images are polymorphic: deleting one through an ImageBase pointer
+    /// (or a smart pointer to it) must run the destructor of the derived class
+    virtual ~ImageBase() {}
     inline int bpp() const { 
         return m_bpp; 
     } 
@@ -67,105 +85,89 @@ public:
         return m_image;
     }
 
+    /// Makes the image use @p pixels, which must already have the image's layout, without copying.
+    /// The caller keeps ownership of @p pixels and must keep them alive while the image uses them.
+    void wrap(T* pixels) {
+        release_image();
+        m_image = pixels;
+        m_owns_image = false;
+    }
+
+    /// The conversions below run in parallel over blocks of CONVERSION_BLOCK pixels, with the
+    /// switch on channels() hoisted out of the pixel loop into a kernel per channel count,
+    /// so the inner loops have a fixed stride and vectorize.
     template<typename I>
     void from_gray(const I* input) {
-        for (unsigned int i = 0; i < m_width * m_height; ++i) {
-            switch(channels()) {
-            case 1: 
-                m_image[i] = static_cast<unsigned char>(input[i]);
-                break;
-            case 3: {
-                int idx = 3 * i;
-                m_image[idx] = static_cast<unsigned char>(input[i]);
-                m_image[idx + 1] = static_cast<unsigned char>(input[i]);
-                m_image[idx + 2] = static_cast<unsigned char>(input[i]);
-                break;
-			}
-            case 4: {
-                int idx = 4 * i;
-                m_image[idx] = static_cast<unsigned char>(input[i]);
-                m_image[idx + 1] = static_cast<unsigned char>(input[i]);
-                m_image[idx + 2] = static_cast<unsigned char>(input[i]);
-                m_image[idx + 3] = 0;
-                break;
-			}
-            default:;
-                //throw io::exception("Invalid number of channels");
+        switch(channels()) {
+        case 1:
+            if (same_layout(input)) {
+                copy_image(reinterpret_cast<const T*>(input));
+            }
+            else {
+                from_gray_kernel<1>(input);
             }
+            break;
+        case 3:
+            from_gray_kernel<3>(input);
+            break;
+        case 4:
+            from_gray_kernel<4>(input);
+            break;
+        default:;
+            //throw io::exception("Invalid number of channels");
         }
     }
 
     template<typename I>
     void from_rgb(I* input) {
-        for (unsigned int i = 0; i < m_width * m_height; ++i) {
-            switch(channels()) {
-            case 1: {
-                int idx = 3 * i;
-                m_image[i] = static_cast<unsigned char>((float(input[idx]) + float(input[idx + 1]) + float(input[idx + 2]))/3.0f);
-                break;
-			}
-			case 3: {
-                int idx = 3 * i;
-                m_image[idx] = static_cast<unsigned char>(input[idx]);
-                m_image[idx + 1] = static_cast<unsigned char>(input[idx + 1]);
-                m_image[idx + 2] = static_cast<unsigned char>(input[idx + 2]);
-                break;
-			}
-            default:;
-                //throw io::exception("Invalid number of channels");
-			}
+        switch(channels()) {
+        case 1:
+            from_rgb_kernel<1>(input);
+            break;
+        case 3:
+            if (same_layout(input)) {
+                copy_image(reinterpret_cast<const T*>(input));
+            }
+            else {
+                from_rgb_kernel<3>(input);
+            }
+            break;
+        default:;
+            //throw io::exception("Invalid number of channels");
         }
     }
 
     template<typename O>
     void to_gray(O* output) {
-        for (unsigned int i = 0; i < m_width * m_height; ++i) {
-            switch(channels()) {
-            case 1: {
-                output[i] = static_cast<O>(m_image[i]);
-                break;
-			}
-            case 3: {
-                int idx = 3 * i;
-                output[i] = static_cast<O>((float(m_image[idx]) + float(m_image[idx + 1]) + float(m_image[idx + 2])) / 3.0f);
-                break;
-			}
-            case 4: {
-                int idx = 4 * i;
-                output[i] = static_cast<O>((float(m_image[idx]) + float(m_image[idx + 1]) + float(m_image[idx + 2])) / 3.0f);
-                break;
-			}
-            default:; 
-                //throw io::exception("Invalid number of channels");
-            }
+        switch(channels()) {
+        case 1:
+            to_gray_kernel<1>(output);
+            break;
+        case 3:
+            to_gray_kernel<3>(output);
+            break;
+        case 4:
+            to_gray_kernel<4>(output);
+            break;
+        default:;
+            //throw io::exception("Invalid number of channels");
         }
     }
 
     template<typename O>
     void to_rgb(O* output) {
-        for (unsigned int i = 0; i < m_width * m_height; ++i) {
-            int idx = 3 * i;
-            switch(channels()) {
-            case 1:
-                output[idx] = static_cast<O>(m_image[i]);
-                output[idx + 1] = static_cast<O>(m_image[i]);
-                output[idx + 1] = static_cast<O>(m_image[i]);
-                break;
-            case 3:
-                output[idx] = static_cast<O>(m_image[idx]);
-                output[idx + 1] = static_cast<O>(m_image[idx + 1]);
-                output[idx + 2] = static_cast<O>(m_image[idx + 2]);
-                break;
-            case 4: {
-                int idx1 = 4 * i;
-                output[idx] = static_cast<O>(m_image[idx1]);
-                output[idx + 1] = static_cast<O>(m_image[idx1 + 1]);
-                output[idx + 2] = static_cast<O>(m_image[idx1 + 2]);
-                break;
-			}
-            default:;
-                //throw io::exception("Invalid number of channels");
-            }
+        switch(channels()) {
+        case 1:
+            to_rgb_kernel<1>(output);
+            break;
+        case 3:
+            to_rgb_kernel<3>(output);
+            break;
+        case 4:
+            to_rgb_kernel<4>(output);
+            break;
+        default:;
+            //throw io::exception("Invalid number of channels");
         }
     }
 
@@ -176,8 +178,12 @@ public:
         if (num_channels == this->channels()) {
             assert(num_channels > 0);
 
-            for (size_t i = 0; i < size_t(m_width) * m_height * num_channels; ++i) {
-                output[i] = static_cast<O>(m_image[i]);
+            const size_t count = size_t(m_width) * m_height * num_channels;
+            cilk_for (size_t block = 0; block < count; block += CONVERSION_BLOCK) {
+                const size_t end = std::min(block + CONVERSION_BLOCK, count);
+                for (size_t i = block; i < end; ++i) {
+                    output[i] = static_cast<O>(m_image[i]);
+                }
             }
         }
         else {
@@ -198,10 +204,7 @@ public:
         m_bpp = 0;
         m_image_size = 0;
 
-        if (m_image) {
-            delete[] m_image;
-            m_image = 0;
-        }
+        release_image();
     }
 
     bool loaded() {
@@ -209,7 +212,104 @@ public:
     }
 
 protected:
+    /// Pixels converted per cilk_for iteration
+    static const size_t CONVERSION_BLOCK = 16384;
+
+    void release_image() {
+        if (m_image && m_owns_image) {
+            delete[] m_image;
+        }
+        m_image = 0;
+        m_owns_image = true;
+    }
+
+    /// True when @p input holds the pixels exactly as m_image does
+    template<typename I>
+    static bool same_layout(const I*) {
+        return same_type<I, T>::value;
+    }
+
+    /// Copies a buffer with the image's own layout, or nothing if it is the image's buffer
+    void copy_image(const T* input) {
+        if (input == m_image) {
+            return;
+        }
+        const size_t count = size_t(m_width) * m_height * channels();
+        cilk_for (size_t block = 0; block < count; block += CONVERSION_BLOCK) {
+            memcpy(m_image + block, input + block, std::min(CONVERSION_BLOCK, count - block) * sizeof(T));
+        }
+    }
+
+    template<unsigned int C, typename I>
+    void from_gray_kernel(const I* __restrict input) {
+        T* __restrict image = m_image;
+        const size_t count = size_t(m_width) * m_height;
+        cilk_for (size_t block = 0; block < count; block += CONVERSION_BLOCK) {
+            const size_t end = std::min(block + CONVERSION_BLOCK, count);
+            for (size_t i = block; i < end; ++i) {
+                const unsigned char v = static_cast<unsigned char>(input[i]);
+                for (unsigned int c = 0; c < (C < 3 ? C : 3); ++c) {
+                    image[C * i + c] = v;
+                }
+                if (C == 4) {
+                    image[C * i + 3] = 0;
+                }
+            }
+        }
+    }
+
+    template<unsigned int C, typename I>
+    void from_rgb_kernel(const I* __restrict input) {
+        T* __restrict image = m_image;
+        const size_t count = size_t(m_width) * m_height;
+        cilk_for (size_t block = 0; block < count; block += CONVERSION_BLOCK) {
+            const size_t end = std::min(block + CONVERSION_BLOCK, count);
+            for (size_t i = block; i < end; ++i) {
+                if (C == 1) {
+                    image[i] = static_cast<unsigned char>((float(input[3 * i]) + float(input[3 * i + 1]) + float(input[3 * i + 2])) / 3.0f);
+                }
+                else {
+                    image[3 * i] = static_cast<unsigned char>(input[3 * i]);
+                    image[3 * i + 1] = static_cast<unsigned char>(input[3 * i + 1]);
+                    image[3 * i + 2] = static_cast<unsigned char>(input[3 * i + 2]);
+                }
+            }
+        }
+    }
+
+    template<unsigned int C, typename O>
+    void to_gray_kernel(O* __restrict output) const {
+        const T* __restrict image = m_image;
+        const size_t count = size_t(m_width) * m_height;
+        cilk_for (size_t block = 0; block < count; block += CONVERSION_BLOCK) {
+            const size_t end = std::min(block + CONVERSION_BLOCK, count);
+            for (size_t i = block; i < end; ++i) {
+                if (C == 1) {
+                    output[i] = static_cast<O>(image[i]);
+                }
+                else {
+                    output[i] = static_cast<O>((float(image[C * i]) + float(image[C * i + 1]) + float(image[C * i + 2])) / 3.0f);
+                }
+            }
+        }
+    }
+
+    template<unsigned int C, typename O>
+    void to_rgb_kernel(O* __restrict output) const {
+        const T* __restrict image = m_image;
+        const size_t count = size_t(m_width) * m_height;
+        cilk_for (size_t block = 0; block < count; block += CONVERSION_BLOCK) {
+            const size_t end = std::min(block + CONVERSION_BLOCK, count);
+            for (size_t i = block; i < end; ++i) {
+                output[3 * i] = static_cast<O>(image[C * i]);
+                output[3 * i + 1] = static_cast<O>(image[C * i + (C == 1 ? 0 : 1)]);
+                output[3 * i + 2] = static_cast<O>(image[C * i + (C == 1 ? 0 : 2)]);
+            }
+        }
+    }
+
     T* m_image;
+    bool m_owns_image;
 
     unsigned int m_width;
     unsigned int m_height;
@@ -24,15 +24,35 @@
 
 #include <cmath>
 #include <complex>
+#include <string>
+#include <vector>
+#include <algorithm>
 #include <cilk/cilk.h>
+#include <cilk/cilk_api.h>
 #include "mandelbrot.h"
+#include "zoom_sequence.h"
+#include "perturbation.h"
 #include "bmp_image.h"
+#include "valsig.h"
 #include "timer.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <emmintrin.h>
 
+// Prints the time each worker spent computing, and the ratio of the busiest worker to the average.
+// A ratio close to 1 means the work was evenly balanced.
+void print_worker_busy(const std::vector<double>& worker_busy) {
+	double total = 0, busiest = 0;
+	for (size_t w = 0; w < worker_busy.size(); ++w) {
+		printf("worker %d busy %f\n", int(w), worker_busy[w]);
+		total += worker_busy[w];
+		busiest = std::max(busiest, worker_busy[w]);
+	}
+	printf("imbalance (max/mean busy) %f\n", busiest * worker_busy.size() / total);
+}
+
 int main(int argc, char* argv[]) {
 	double x0 = -2.5;
 	double y0 = -0.875;
@@ -44,7 +64,24 @@ int main(int argc, char* argv[]) {
 	assert(width%8==0);
 	int max_depth = 100;
 
+	// Selects the kernel, as in "make run option=4"
+	// 3: cilk_for over rows, 4: cilk_for over 2D tiles with SIMD lane groups,
+	// 5: cost-driven recursive splitting with cilk_spawn,
+	// 6: Mariani-Silver rectangle subdivision, 7: same with the periodicity check,
+	// 8: zoom sequence with pipelined frame output ("make run option='8 <frames>'"),
+	// 9: deep zoom with perturbation theory ("make run option='9 <span> <depth>'")
+	// Options 3 to 7 take the depth as a second argument, as in "make run option='6 255'"
+	// "mandelbrot -compare <a.valsig> <b.valsig>" compares two signatures instead
+	if (argc > 3 && strcmp(argv[1], "-compare") == 0) {
+		return io::compare_valsig(argv[2], argv[3]) == 0 ? 0 : 1;
+	}
 	int option = 3;
+	if (argc > 1) {
+		option = atoi(argv[1]);
+	}
+	if (option >= 3 && option <= 7 && argc > 2) {
+		max_depth = atoi(argv[2]);
+	}
 
 	CUtilTimer timer;
 	double serial_time, vec_time, cilk_time, cilk_vec_time;
@@ -56,17 +93,78 @@ int main(int argc, char* argv[]) {
 	}
 
 	io::BMPImage image(width, height, 8);
+	std::vector<double> worker_busy(__cilkrts_get_nworkers());
 	unsigned char* output;
-    //    printf("\nStarting cilk_for Mandelbrot...\n");
+	std::string name;
+	switch (option) {
+	case 3:
+		//    printf("\nStarting cilk_for Mandelbrot...\n");
 		timer.start();
 		output = cilk_mandelbrot(x0, y0, x1, y1, width, height, max_depth);
 		timer.stop();
-		printf("%f\n", timer.get_time());
-		//printf("Saving image...\n");
-		image.from_gray(output);
-		image.save("mandelbrot_cilk.bmp");
-		image.valsig("mandelbrot_cilk.valsig");
-		_mm_free(output);
+		name = "mandelbrot_cilk";
+		break;
+	case 4:
+		timer.start();
+		output = simd_mandelbrot(x0, y0, x1, y1, width, height, max_depth, &worker_busy[0]);
+		timer.stop();
+		print_worker_busy(worker_busy);
+		name = "mandelbrot_simd";
+		break;
+	case 5:
+		timer.start();
+		output = adaptive_mandelbrot(x0, y0, x1, y1, width, height, max_depth, 0, &worker_busy[0]);
+		timer.stop();
+		print_worker_busy(worker_busy);
+		name = "mandelbrot_adaptive";
+		break;
+	case 6:
+		timer.start();
+		output = mariani_silver_mandelbrot(x0, y0, x1, y1, width, height, max_depth);
+		timer.stop();
+		name = "mandelbrot_mariani";
+		break;
+	case 7:
+		timer.start();
+		output = mariani_silver_mandelbrot(x0, y0, x1, y1, width, height, max_depth, true);
+		timer.stop();
+		name = "mandelbrot_mariani_periodic";
+		break;
+	case 8: {
+		// Zoom into the seahorse valley, shrinking the frame by 10% per frame
+		ZoomPath path = { x0, y0, x1, y1, -0.743643887037151, 0.131825904205330, 0.9, 16 };
+		if (argc > 2) {
+			path.frames = atoi(argv[2]);
+		}
+		double sequence_time = render_zoom_sequence(path, width, height, max_depth, "mandelbrot_zoom");
+		printf("%d frames, %f frames/s\n", path.frames, path.frames / sequence_time);
+		printf("%f\n", sequence_time);
+		return 0;
+	}
+	case 9: {
+		// Deep zoom into the seahorse valley, "make run option='9 <span> <depth>'"
+		double span = argc > 2 ? atof(argv[2]) : 1e-14;
+		int deep_depth = argc > 3 ? atoi(argv[3]) : 10000;
+		PerturbationStats stats;
+		timer.start();
+		output = perturbation_mandelbrot("-0.743643887037158704752191506114774", "0.131825904205311970493132056385139",
+		                                 span, width, height, deep_depth, &stats);
+		timer.stop();
+		printf("reference orbit %d iterations, %d limbs, %lld rebases\n", stats.reference_length, stats.limbs, stats.rebases);
+		name = "mandelbrot_perturbation";
+		break;
+	}
+	default:
+		printf("Unknown option %d\n", option);
+		return 1;
+	}
+	printf("%f\n", timer.get_time());
+	//printf("Saving image...\n");
+	// The 8 bit image has the layout of output already, so it is saved from output directly
+	image.wrap(output);
+	image.save(name + ".bmp");
+	image.valsig(name + ".valsig", name + ".digest");
+	_mm_free(output);
 
     return 0;
 }
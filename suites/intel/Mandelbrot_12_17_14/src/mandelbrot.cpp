@@ -15,7 +15,11 @@
 // On top of the serial/scalar version, there is a cilk_for version, a pragma simd version, and a combined cilk_for/pragma simd version
 
 #include "mandelbrot.h"
+#include "simd_lanes.h"
+#include "timer.h"
 #include <complex>
+#include <algorithm>
+#include <cstring>
 
 #include <cilk/cilk.h>
 
@@ -23,6 +27,44 @@
 
 #include <cilk/cilk_api.h>
 
+// Description:
+// Scalar depth of a single point c, computed exactly as in the cilk_mandelbrot loop.
+// With periodicity, the orbit is saved at iterations 1, 2, 4, 8, ... and a point whose z comes
+// back exactly to the saved value is known to stay bounded, so it returns max_depth at once.
+//
+// [in]: c_real, c_imaginary, max_depth, periodicity
+// [out]: number of iterations before divergence, up to max_depth
+double mandelbrot_depth(double c_real, double c_imaginary, int max_depth, bool periodicity) {
+  double z_real = c_real;
+  double z_imaginary = c_imaginary;
+  double saved_real = z_real;
+  double saved_imaginary = z_imaginary;
+  double next_save = 1;
+  double depth = 0;
+  while(depth < max_depth) {
+    if(z_real * z_real + z_imaginary * z_imaginary > 4.0) {
+      break; // Escape from a circle of radius 2
+    }
+    double temp_real = z_real*z_real - z_imaginary*z_imaginary;
+    double temp_imaginary = 2.0*z_real*z_imaginary;
+    z_real = c_real + temp_real;
+    z_imaginary = c_imaginary + temp_imaginary;
+
+    ++depth;
+    if (periodicity) {
+      if (z_real == saved_real && z_imaginary == saved_imaginary) {
+        return max_depth;
+      }
+      if (depth == next_save) {
+        saved_real = z_real;
+        saved_imaginary = z_imaginary;
+        next_save *= 2;
+      }
+    }
+  }
+  return depth;
+}
+
 // Description:
 // Determines how deeply points in the complex plane, spaced on a uniform grid, remain in the Mandelbrot set.
 // The uniform grid is specified by the rectangle (x1, y1) - (x0, y0).
@@ -65,3 +107,393 @@ unsigned char* cilk_mandelbrot(double x0, double y0, double x1, double y1,
   }
   return output;
 }
+
+// Description:
+// Evaluates the pixels of one tile of the cilk_mandelbrot grid, one SIMD lane group at a time.
+// The tile has its top left corner at (tile_x, tile_y); pixels left over at the right edge
+// of a tile row, when tile_width is not a multiple of simd::LANES, are evaluated with scalar code.
+//
+// [in]: x0, y0, xstep, ystep, width, max_depth, tile_x, tile_y, tile_width, tile_height, periodicity
+// [out]: output (the tile's pixels of the width-wide image)
+void mandelbrot_tile(double x0, double y0, double xstep, double ystep, int width, int max_depth,
+                     int tile_x, int tile_y, int tile_width, int tile_height, unsigned char* output,
+                     bool periodicity) {
+  const simd::vdouble lane_offsets = simd::ramp();
+  const simd::vdouble vxstep = simd::set1(xstep);
+  const simd::vdouble vx0 = simd::set1(x0);
+  double depth[simd::LANES];
+  for (int j = tile_y; j < tile_y + tile_height; ++j) {
+    unsigned char* row = output + j*width;
+    simd::vdouble c_imaginary = simd::set1(y0 + j*ystep);
+    int i = tile_x;
+    for (; i + simd::LANES <= tile_x + tile_width; i += simd::LANES) {
+      simd::vdouble c_real = simd::add(vx0, simd::mul(simd::add(simd::set1(i), lane_offsets), vxstep));
+      simd::store(depth, periodicity ? simd::escape_depth_periodic(c_real, c_imaginary, max_depth)
+                                     : simd::escape_depth(c_real, c_imaginary, max_depth));
+      for (int k = 0; k < simd::LANES; ++k) {
+        row[i + k] = static_cast<unsigned char>(depth[k] / max_depth * 255);
+      }
+    }
+    for (; i < tile_x + tile_width; ++i) {
+      row[i] = static_cast<unsigned char>(mandelbrot_depth(x0 + i*xstep, y0 + j*ystep, max_depth, periodicity) / max_depth * 255);
+    }
+  }
+}
+
+// Description:
+// Evaluates a single column of pixels of the cilk_mandelbrot grid, with the SIMD lane groups
+// running down the column. Used for the left and right borders of the Mariani-Silver rectangles.
+//
+// [in]: x0, y0, xstep, ystep, width, max_depth, column, row_begin, row_end, periodicity
+// [out]: output (pixels (column, row_begin) to (column, row_end - 1) of the width-wide image)
+static void mandelbrot_column(double x0, double y0, double xstep, double ystep, int width, int max_depth,
+                              int column, int row_begin, int row_end, unsigned char* output,
+                              bool periodicity) {
+  const simd::vdouble lane_offsets = simd::ramp();
+  const simd::vdouble vystep = simd::set1(ystep);
+  const simd::vdouble vy0 = simd::set1(y0);
+  const simd::vdouble c_real = simd::set1(x0 + column*xstep);
+  double depth[simd::LANES];
+  int j = row_begin;
+  for (; j + simd::LANES <= row_end; j += simd::LANES) {
+    simd::vdouble c_imaginary = simd::add(vy0, simd::mul(simd::add(simd::set1(j), lane_offsets), vystep));
+    simd::store(depth, periodicity ? simd::escape_depth_periodic(c_real, c_imaginary, max_depth)
+                                   : simd::escape_depth(c_real, c_imaginary, max_depth));
+    for (int k = 0; k < simd::LANES; ++k) {
+      output[(j + k)*width + column] = static_cast<unsigned char>(depth[k] / max_depth * 255);
+    }
+  }
+  for (; j < row_end; ++j) {
+    output[j*width + column] = static_cast<unsigned char>(mandelbrot_depth(x0 + column*xstep, y0 + j*ystep, max_depth, periodicity) / max_depth * 255);
+  }
+}
+
+// Busy time of one Cilk worker, padded to a cache line so workers do not share lines
+struct WorkerBusy {
+  double seconds;
+  char padding[64 - sizeof(double)];
+};
+
+static std::vector<WorkerBusy> make_worker_busy() {
+  WorkerBusy zero = WorkerBusy();
+  return std::vector<WorkerBusy>(__cilkrts_get_nworkers(), zero);
+}
+
+static void copy_worker_busy(const std::vector<WorkerBusy>& busy, double* worker_busy) {
+  if (worker_busy) {
+    for (size_t w = 0; w < busy.size(); ++w) {
+      worker_busy[w] = busy[w].seconds;
+    }
+  }
+}
+
+// Computes a tile and charges its time to the worker running it
+static void timed_tile(double x0, double y0, double xstep, double ystep, int width, int max_depth,
+                       int tile_x, int tile_y, int tile_width, int tile_height, unsigned char* output,
+                       std::vector<WorkerBusy>& busy) {
+  CUtilTimer timer;
+  timer.start();
+  mandelbrot_tile(x0, y0, xstep, ystep, width, max_depth, tile_x, tile_y, tile_width, tile_height, output);
+  timer.stop();
+  // No spawn happens between here and the tile, so the strand is still on the same worker
+  busy[__cilkrts_get_worker_number()].seconds += timer.get_time();
+}
+
+// Description:
+// Same grid and output as cilk_mandelbrot, but the image is cut into 2D tiles of
+// MANDELBROT_TILE_WIDTH x MANDELBROT_TILE_HEIGHT pixels which are scheduled with cilk_for,
+// and each tile row is evaluated one SIMD lane group at a time with per-lane escape masks.
+// A tile spans several rows, so the expensive rows crossing the set are spread over many tiles.
+//
+// [in]: x0, y0, x1, y1, width, height, max_depth
+// [out]: output (caller must deallocate)
+unsigned char* simd_mandelbrot(double x0, double y0, double x1, double y1,
+                               int width, int height, int max_depth, double* worker_busy) {
+  double xstep = (x1 - x0) / width;
+  double ystep = (y1 - y0) / height;
+  unsigned char* output = static_cast<unsigned char*>(_mm_malloc(width * height * sizeof(unsigned char), 64));
+  std::vector<WorkerBusy> busy = make_worker_busy();
+  int tiles_x = (width + MANDELBROT_TILE_WIDTH - 1) / MANDELBROT_TILE_WIDTH;
+  int tiles_y = (height + MANDELBROT_TILE_HEIGHT - 1) / MANDELBROT_TILE_HEIGHT;
+  cilk_for(int t = 0; t < tiles_x * tiles_y; ++t) {
+    timed_tile(x0, y0, xstep, ystep, width, max_depth,
+               (t % tiles_x) * MANDELBROT_TILE_WIDTH, (t / tiles_x) * MANDELBROT_TILE_HEIGHT,
+               std::min(MANDELBROT_TILE_WIDTH, width - (t % tiles_x) * MANDELBROT_TILE_WIDTH),
+               std::min(MANDELBROT_TILE_HEIGHT, height - (t / tiles_x) * MANDELBROT_TILE_HEIGHT),
+               output, busy);
+  }
+  copy_worker_busy(busy, worker_busy);
+  return output;
+}
+
+void MandelbrotCostMap::resize(int width, int height) {
+  cells_x = (width + MANDELBROT_CELL_WIDTH - 1) / MANDELBROT_CELL_WIDTH;
+  cells_y = (height + MANDELBROT_CELL_HEIGHT - 1) / MANDELBROT_CELL_HEIGHT;
+  sat.assign(size_t(cells_x + 1) * (cells_y + 1), 0.0);
+}
+
+// Description:
+// Turns the per-cell costs, stored at sat[(cy + 1) * (cells_x + 1) + cx + 1], into a summed area table.
+// Row 0 and column 0 of the table stay zero.
+void MandelbrotCostMap::integrate() {
+  const int stride = cells_x + 1;
+  for (int cy = 1; cy <= cells_y; ++cy) {
+    double row_sum = 0;
+    for (int cx = 1; cx <= cells_x; ++cx) {
+      row_sum += sat[cy*stride + cx];
+      sat[cy*stride + cx] = sat[(cy - 1)*stride + cx] + row_sum;
+    }
+  }
+}
+
+double MandelbrotCostMap::cost(int cx0, int cy0, int cx1, int cy1) const {
+  const int stride = cells_x + 1;
+  return sat[cy1*stride + cx1] - sat[cy0*stride + cx1] - sat[cy1*stride + cx0] + sat[cy0*stride + cx0];
+}
+
+// Description:
+// Samples the grid every MANDELBROT_COST_STRIDE pixels in each direction, and charges each cell
+// the iterations of its samples, plus one per sample for the fixed per-pixel cost.
+//
+// [in]: x0, y0, x1, y1, width, height, max_depth
+// [out]: costs
+void mandelbrot_cost_prepass(double x0, double y0, double x1, double y1, int width, int height,
+                             int max_depth, MandelbrotCostMap& costs) {
+  double xstep = (x1 - x0) / width;
+  double ystep = (y1 - y0) / height;
+  costs.resize(width, height);
+  const int stride = costs.cells_x + 1;
+  cilk_for(int cy = 0; cy < costs.cells_y; ++cy) {
+    int j_end = std::min((cy + 1) * MANDELBROT_CELL_HEIGHT, height);
+    for (int cx = 0; cx < costs.cells_x; ++cx) {
+      int i_end = std::min((cx + 1) * MANDELBROT_CELL_WIDTH, width);
+      double cell_cost = 0;
+      for (int j = cy * MANDELBROT_CELL_HEIGHT + MANDELBROT_COST_STRIDE / 2; j < j_end; j += MANDELBROT_COST_STRIDE) {
+        for (int i = cx * MANDELBROT_CELL_WIDTH + MANDELBROT_COST_STRIDE / 2; i < i_end; i += MANDELBROT_COST_STRIDE) {
+          cell_cost += mandelbrot_depth(x0 + i*xstep, y0 + j*ystep, max_depth) + 1;
+        }
+      }
+      costs.sat[(cy + 1)*stride + cx + 1] = cell_cost;
+    }
+  }
+  costs.integrate();
+}
+
+// Description:
+// Same sampling as mandelbrot_cost_prepass, but reads the depths back from a frame
+// rendered earlier at the same size instead of iterating.
+//
+// [in]: frame, width, height
+// [out]: costs
+void mandelbrot_cost_from_frame(const unsigned char* frame, int width, int height, MandelbrotCostMap& costs) {
+  costs.resize(width, height);
+  const int stride = costs.cells_x + 1;
+  cilk_for(int cy = 0; cy < costs.cells_y; ++cy) {
+    int j_end = std::min((cy + 1) * MANDELBROT_CELL_HEIGHT, height);
+    for (int cx = 0; cx < costs.cells_x; ++cx) {
+      int i_end = std::min((cx + 1) * MANDELBROT_CELL_WIDTH, width);
+      double cell_cost = 0;
+      for (int j = cy * MANDELBROT_CELL_HEIGHT + MANDELBROT_COST_STRIDE / 2; j < j_end; j += MANDELBROT_COST_STRIDE) {
+        for (int i = cx * MANDELBROT_CELL_WIDTH + MANDELBROT_COST_STRIDE / 2; i < i_end; i += MANDELBROT_COST_STRIDE) {
+          cell_cost += frame[j*width + i] + 1;
+        }
+      }
+      costs.sat[(cy + 1)*stride + cx + 1] = cell_cost;
+    }
+  }
+  costs.integrate();
+}
+
+// Everything the recursive splitting of adaptive_mandelbrot needs besides the region itself
+struct AdaptiveContext {
+  double x0, y0, xstep, ystep;
+  int width, height, max_depth;
+  const MandelbrotCostMap* costs;
+  double grain;
+  unsigned char* output;
+  std::vector<WorkerBusy>* busy;
+};
+
+// Returns the split point in (lo, hi) that brings the cost of [lo, split) closest to half the region's cost
+static int cost_median(const AdaptiveContext& ctx, int cx0, int cy0, int cx1, int cy1, bool along_x) {
+  const int lo = along_x ? cx0 : cy0;
+  const int hi = along_x ? cx1 : cy1;
+  const double half = ctx.costs->cost(cx0, cy0, cx1, cy1) / 2;
+  int first = lo + 1, last = hi - 1;
+  while (first < last) {
+    int mid = (first + last) / 2;
+    double left = along_x ? ctx.costs->cost(cx0, cy0, mid, cy1) : ctx.costs->cost(cx0, cy0, cx1, mid);
+    if (left < half) {
+      first = mid + 1;
+    }
+    else {
+      last = mid;
+    }
+  }
+  return first;
+}
+
+// Description:
+// Computes the cells [cx0, cx1) x [cy0, cy1). A region costing more than ctx.grain is split
+// across its longer side at the cost median, and the two halves run in parallel.
+static void adaptive_region(const AdaptiveContext& ctx, int cx0, int cy0, int cx1, int cy1) {
+  bool splittable = cx1 - cx0 > 1 || cy1 - cy0 > 1;
+  if (!splittable || ctx.costs->cost(cx0, cy0, cx1, cy1) <= ctx.grain) {
+    int tile_x = cx0 * MANDELBROT_CELL_WIDTH;
+    int tile_y = cy0 * MANDELBROT_CELL_HEIGHT;
+    timed_tile(ctx.x0, ctx.y0, ctx.xstep, ctx.ystep, ctx.width, ctx.max_depth, tile_x, tile_y,
+               std::min(cx1 * MANDELBROT_CELL_WIDTH, ctx.width) - tile_x,
+               std::min(cy1 * MANDELBROT_CELL_HEIGHT, ctx.height) - tile_y,
+               ctx.output, *ctx.busy);
+    return;
+  }
+  bool along_x = cy1 - cy0 == 1 ||
+    (cx1 - cx0 > 1 && (cx1 - cx0) * MANDELBROT_CELL_WIDTH >= (cy1 - cy0) * MANDELBROT_CELL_HEIGHT);
+  int split = cost_median(ctx, cx0, cy0, cx1, cy1, along_x);
+  if (along_x) {
+    cilk_spawn adaptive_region(ctx, cx0, cy0, split, cy1);
+    adaptive_region(ctx, split, cy0, cx1, cy1);
+  }
+  else {
+    cilk_spawn adaptive_region(ctx, cx0, cy0, cx1, split);
+    adaptive_region(ctx, cx0, split, cx1, cy1);
+  }
+  cilk_sync;
+}
+
+// Description:
+// Same grid and output as cilk_mandelbrot, scheduled by cost instead of by rows.
+// The image is split recursively at cost medians until a region is estimated to cost less
+// than 1/(ADAPTIVE_PIECES_PER_WORKER * workers) of the whole image, so every worker
+// gets many pieces of roughly equal work, whichever rows the set crosses.
+//
+// [in]: x0, y0, x1, y1, width, height, max_depth, costs (optional)
+// [out]: output (width * height bytes owned by the caller), worker_busy (optional)
+void adaptive_mandelbrot_frame(double x0, double y0, double x1, double y1,
+                               int width, int height, int max_depth, unsigned char* output,
+                               const MandelbrotCostMap* costs, double* worker_busy) {
+  const int ADAPTIVE_PIECES_PER_WORKER = 16;
+  MandelbrotCostMap prepass_costs;
+  if (!costs) {
+    mandelbrot_cost_prepass(x0, y0, x1, y1, width, height, max_depth, prepass_costs);
+    costs = &prepass_costs;
+  }
+  std::vector<WorkerBusy> busy = make_worker_busy();
+
+  AdaptiveContext ctx;
+  ctx.x0 = x0;
+  ctx.y0 = y0;
+  ctx.xstep = (x1 - x0) / width;
+  ctx.ystep = (y1 - y0) / height;
+  ctx.width = width;
+  ctx.height = height;
+  ctx.max_depth = max_depth;
+  ctx.costs = costs;
+  ctx.grain = costs->cost(0, 0, costs->cells_x, costs->cells_y) / (ADAPTIVE_PIECES_PER_WORKER * busy.size());
+  ctx.output = output;
+  ctx.busy = &busy;
+  adaptive_region(ctx, 0, 0, costs->cells_x, costs->cells_y);
+
+  copy_worker_busy(busy, worker_busy);
+}
+
+// Description:
+// adaptive_mandelbrot_frame into a newly allocated image
+//
+// [in]: x0, y0, x1, y1, width, height, max_depth, costs (optional)
+// [out]: output (caller must deallocate), worker_busy (optional)
+unsigned char* adaptive_mandelbrot(double x0, double y0, double x1, double y1,
+                                   int width, int height, int max_depth,
+                                   const MandelbrotCostMap* costs, double* worker_busy) {
+  unsigned char* output = static_cast<unsigned char*>(_mm_malloc(width * height * sizeof(unsigned char), 64));
+  adaptive_mandelbrot_frame(x0, y0, x1, y1, width, height, max_depth, output, costs, worker_busy);
+  return output;
+}
+
+// Everything the Mariani-Silver recursion needs besides the rectangle itself
+struct MarianiContext {
+  double x0, y0, xstep, ystep;
+  int width, max_depth;
+  bool periodicity;
+  unsigned char* output;
+};
+
+// Returns true if the pixels [begin, end) read with the given stride all equal value
+static bool uniform(const unsigned char* pixels, int begin, int end, int stride, unsigned char value) {
+  for (int k = begin; k < end; ++k) {
+    if (pixels[k * stride] != value) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Description:
+// Mariani-Silver subdivision of the rectangle with top left pixel (x, y) and size w x h.
+// Only the border of the rectangle is iterated. If every border pixel has the same value the
+// interior is filled with it, otherwise the rectangle is halved across its longer side and
+// both halves are processed in parallel. Halves never overlap, so a worker only ever writes
+// pixels inside its own rectangle; they recompute the border pixels they share with the parent,
+// which costs one row or column per split.
+// Rectangles smaller than MARIANI_MIN_SIZE on a side are computed pixel by pixel.
+static void mariani_region(const MarianiContext& ctx, int x, int y, int w, int h) {
+  if (w < MARIANI_MIN_SIZE || h < MARIANI_MIN_SIZE) {
+    mandelbrot_tile(ctx.x0, ctx.y0, ctx.xstep, ctx.ystep, ctx.width, ctx.max_depth,
+                    x, y, w, h, ctx.output, ctx.periodicity);
+    return;
+  }
+  unsigned char* corner = ctx.output + y*ctx.width + x;
+  mandelbrot_tile(ctx.x0, ctx.y0, ctx.xstep, ctx.ystep, ctx.width, ctx.max_depth,
+                  x, y, w, 1, ctx.output, ctx.periodicity);
+  mandelbrot_tile(ctx.x0, ctx.y0, ctx.xstep, ctx.ystep, ctx.width, ctx.max_depth,
+                  x, y + h - 1, w, 1, ctx.output, ctx.periodicity);
+  mandelbrot_column(ctx.x0, ctx.y0, ctx.xstep, ctx.ystep, ctx.width, ctx.max_depth,
+                    x, y + 1, y + h - 1, ctx.output, ctx.periodicity);
+  mandelbrot_column(ctx.x0, ctx.y0, ctx.xstep, ctx.ystep, ctx.width, ctx.max_depth,
+                    x + w - 1, y + 1, y + h - 1, ctx.output, ctx.periodicity);
+
+  const unsigned char value = corner[0];
+  if (uniform(corner, 0, w, 1, value) && uniform(corner + (h - 1)*ctx.width, 0, w, 1, value) &&
+      uniform(corner, 1, h - 1, ctx.width, value) && uniform(corner + w - 1, 1, h - 1, ctx.width, value)) {
+    for (int j = 1; j < h - 1; ++j) {
+      memset(corner + j*ctx.width + 1, value, w - 2);
+    }
+    return;
+  }
+
+  if (w >= h) {
+    // Keep the split on a multiple of the lane count so the rows stay in whole lane groups
+    int half = (w / 2) / simd::LANES * simd::LANES;
+    cilk_spawn mariani_region(ctx, x, y, half, h);
+    mariani_region(ctx, x + half, y, w - half, h);
+  }
+  else {
+    int half = h / 2;
+    cilk_spawn mariani_region(ctx, x, y, w, half);
+    mariani_region(ctx, x, y + half, w, h - half);
+  }
+  cilk_sync;
+}
+
+// Description:
+// Same grid and output as cilk_mandelbrot, using Mariani-Silver rectangle subdivision so that
+// large uniform regions, such as the interior of the set, are filled instead of iterated.
+// With periodicity, orbits that come back exactly to an earlier value stop iterating early.
+//
+// [in]: x0, y0, x1, y1, width, height, max_depth, periodicity
+// [out]: output (caller must deallocate)
+unsigned char* mariani_silver_mandelbrot(double x0, double y0, double x1, double y1,
+                                         int width, int height, int max_depth, bool periodicity) {
+  unsigned char* output = static_cast<unsigned char*>(_mm_malloc(width * height * sizeof(unsigned char), 64));
+  MarianiContext ctx;
+  ctx.x0 = x0;
+  ctx.y0 = y0;
+  ctx.xstep = (x1 - x0) / width;
+  ctx.ystep = (y1 - y0) / height;
+  ctx.width = width;
+  ctx.max_depth = max_depth;
+  ctx.periodicity = periodicity;
+  ctx.output = output;
+  mariani_region(ctx, 0, 0, width, height);
+  return output;
+}
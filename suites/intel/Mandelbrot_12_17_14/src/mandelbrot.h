@@ -14,10 +14,91 @@
 #ifndef MANDELBROT_H
 #define MANDELBROT_H
 
+#include <vector>
+
 // Checks how many iterations of the complex quadratic polynomial z_n+1 = z_n^2 + c
 // keeps a set of complex numbers bounded, to a certain max depth
 // Mapping of these depths to a complex plane will result in the telltale mandelbrot set image
 // Uses cilk_for loops to iterate through set
 unsigned char* cilk_mandelbrot(double x0, double y0, double x1, double y1, int width, 
 					     int height, int max_depth);
+
+// Tile size used by the tiled kernels. The width is a multiple of every SIMD lane count,
+// and a tile of output bytes (8 KB) stays in L1 while it is being written.
+const int MANDELBROT_TILE_WIDTH = 256;
+const int MANDELBROT_TILE_HEIGHT = 32;
+
+// Returns the depth reached by a single point c, exactly as computed by cilk_mandelbrot
+// With periodicity, an orbit that comes back exactly to an earlier value returns max_depth early
+double mandelbrot_depth(double c_real, double c_imaginary, int max_depth, bool periodicity = false);
+
+// Computes one tile of the cilk_mandelbrot grid, with (tile_x, tile_y) its top left pixel,
+// using SIMD lane groups with per-lane escape masks
+void mandelbrot_tile(double x0, double y0, double xstep, double ystep, int width, int max_depth,
+                     int tile_x, int tile_y, int tile_width, int tile_height, unsigned char* output,
+                     bool periodicity = false);
+
+// Same result as cilk_mandelbrot, computed over 2D tiles scheduled with cilk_for,
+// each tile evaluated with SIMD lane groups
+// If worker_busy is not null, it receives the seconds each Cilk worker spent computing tiles
+// (one entry per worker, __cilkrts_get_nworkers() entries)
+unsigned char* simd_mandelbrot(double x0, double y0, double x1, double y1, int width,
+					     int height, int max_depth, double* worker_busy = 0);
+
+// Cell size of the cost map used by adaptive_mandelbrot. The cell is the smallest unit of work
+// the adaptive scheduler hands out; the pre-pass samples every 8th pixel of a cell in each direction.
+const int MANDELBROT_CELL_WIDTH = 32;
+const int MANDELBROT_CELL_HEIGHT = 8;
+const int MANDELBROT_COST_STRIDE = 8;
+
+// Estimated cost of every cell of the image, stored as a summed area table
+// so the cost of any rectangle of cells is found in constant time
+struct MandelbrotCostMap {
+  int cells_x;
+  int cells_y;
+  std::vector<double> sat;
+
+  void resize(int width, int height);
+  // Builds the summed area table from the per-cell costs already stored in sat
+  void integrate();
+  // Cost of the cells [cx0, cx1) x [cy0, cy1)
+  double cost(int cx0, int cy0, int cx1, int cy1) const;
+};
+
+// Estimates the cell costs from a low resolution pre-pass over the cilk_mandelbrot grid
+void mandelbrot_cost_prepass(double x0, double y0, double x1, double y1, int width, int height,
+                             int max_depth, MandelbrotCostMap& costs);
+
+// Estimates the cell costs from a previous frame of the same size (the gray value is proportional to depth)
+void mandelbrot_cost_from_frame(const unsigned char* frame, int width, int height, MandelbrotCostMap& costs);
+
+// Same result as cilk_mandelbrot, with the image recursively split along cost medians
+// and the halves spawned with cilk_spawn, until a piece costs less than a fraction of the
+// whole image's cost. Expensive regions crossing the set thus end up cut into many small pieces.
+// costs may come from a previous frame; when it is null a pre-pass estimates it.
+// worker_busy is as in simd_mandelbrot.
+unsigned char* adaptive_mandelbrot(double x0, double y0, double x1, double y1, int width,
+					     int height, int max_depth, const MandelbrotCostMap* costs = 0,
+					     double* worker_busy = 0);
+
+// Same as adaptive_mandelbrot, rendering into a caller-owned buffer of width * height bytes
+void adaptive_mandelbrot_frame(double x0, double y0, double x1, double y1, int width,
+					     int height, int max_depth, unsigned char* output,
+					     const MandelbrotCostMap* costs = 0, double* worker_busy = 0);
+
+// Rectangles with a side shorter than this are computed pixel by pixel by mariani_silver_mandelbrot.
+// A uniform border does not strictly prove a uniform interior: thin filaments of the set can slip
+// between border pixels. Smaller rectangles are where that happens, and with 64 the output on the
+// benchmark grid matches cilk_mandelbrot exactly at depths 100, 255 and 1000 ("make check_mariani").
+const int MARIANI_MIN_SIZE = 64;
+
+// Approximation of cilk_mandelbrot by Mariani-Silver subdivision: only the border of a rectangle
+// is iterated, a rectangle with a uniform border is filled, and any other rectangle is split in
+// two halves which are spawned with cilk_spawn. Filling a rectangle from its border is a heuristic,
+// so the result is only known to be identical to cilk_mandelbrot where it has been checked: on the
+// benchmark grid at depths 100, 255 and 1000, by "make check_mariani". Another grid or depth may
+// lose filament pixels inside filled rectangles.
+// periodicity enables the exact periodicity check for interior points, which changes no depth.
+unsigned char* mariani_silver_mandelbrot(double x0, double y0, double x1, double y1, int width,
+					     int height, int max_depth, bool periodicity = false);
 #endif // MANDELBROT_H
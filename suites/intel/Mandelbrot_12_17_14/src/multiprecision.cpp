@@ -0,0 +1,175 @@
+//==============================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2010-2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ===============================================================
+
+#include "multiprecision.h"
+
+#include <cassert>
+#include <cmath>
+
+FixedPoint::FixedPoint(int limbs):
+    m_limbs(limbs, 0u),
+    m_negative(false)
+{
+    assert(limbs >= 2);
+}
+
+FixedPoint::FixedPoint(int limbs, double value):
+    m_limbs(limbs, 0u),
+    m_negative(value < 0)
+{
+    assert(limbs >= 2);
+    double magnitude = std::fabs(value);
+    // Peel off 32 bits at a time, from the integer part down
+    for (int k = limbs - 1; k >= 0 && magnitude > 0; --k) {
+        double limb = std::floor(magnitude);
+        m_limbs[k] = static_cast<unsigned int>(limb);
+        magnitude = (magnitude - limb) * 4294967296.0;
+    }
+}
+
+// Description:
+// The integer digits go straight into the integer limb. The fraction is built from its
+// last digit up, as frac = (frac + digit) / 10, which only needs division by a small integer.
+FixedPoint::FixedPoint(int limbs, const std::string& decimal):
+    m_limbs(limbs, 0u),
+    m_negative(false)
+{
+    assert(limbs >= 2);
+    size_t pos = 0;
+    if (pos < decimal.size() && (decimal[pos] == '-' || decimal[pos] == '+')) {
+        m_negative = decimal[pos] == '-';
+        ++pos;
+    }
+    unsigned int integer = 0;
+    for (; pos < decimal.size() && decimal[pos] != '.'; ++pos) {
+        integer = integer * 10 + (decimal[pos] - '0');
+    }
+    size_t fraction_begin = pos + 1;
+    for (size_t digit = decimal.size(); digit > fraction_begin; --digit) {
+        // The digit sits in the integer position and is divided down together with the fraction
+        unsigned long long remainder = static_cast<unsigned int>(decimal[digit - 1] - '0');
+        for (int k = limbs - 2; k >= 0; --k) {
+            unsigned long long current = (remainder << 32) | m_limbs[k];
+            m_limbs[k] = static_cast<unsigned int>(current / 10);
+            remainder = current % 10;
+        }
+    }
+    m_limbs[limbs - 1] = integer;
+    if (is_zero()) {
+        m_negative = false;
+    }
+}
+
+double FixedPoint::to_double() const {
+    double value = 0;
+    double scale = 1;
+    for (int k = limbs() - 1; k >= 0; --k) {
+        value += m_limbs[k] * scale;
+        scale /= 4294967296.0;
+    }
+    return m_negative ? -value : value;
+}
+
+int FixedPoint::limbs_for(double step) {
+    int bits = static_cast<int>(std::ceil(-std::log2(step))) + 64;
+    return 1 + (bits + 31) / 32;
+}
+
+bool FixedPoint::is_zero() const {
+    for (int k = 0; k < limbs(); ++k) {
+        if (m_limbs[k]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int FixedPoint::compare_magnitude(const FixedPoint& y) const {
+    for (int k = limbs() - 1; k >= 0; --k) {
+        if (m_limbs[k] != y.m_limbs[k]) {
+            return m_limbs[k] < y.m_limbs[k] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+void FixedPoint::add_magnitude(const FixedPoint& y) {
+    unsigned long long carry = 0;
+    for (int k = 0; k < limbs(); ++k) {
+        unsigned long long sum = carry + m_limbs[k] + y.m_limbs[k];
+        m_limbs[k] = static_cast<unsigned int>(sum);
+        carry = sum >> 32;
+    }
+}
+
+void FixedPoint::subtract_magnitude(const FixedPoint& y) {
+    long long borrow = 0;
+    for (int k = 0; k < limbs(); ++k) {
+        long long difference = static_cast<long long>(m_limbs[k]) - y.m_limbs[k] - borrow;
+        borrow = difference < 0;
+        m_limbs[k] = static_cast<unsigned int>(difference + (borrow << 32));
+    }
+}
+
+FixedPoint FixedPoint::operator+(const FixedPoint& y) const {
+    assert(limbs() == y.limbs());
+    FixedPoint result(*this);
+    if (m_negative == y.m_negative) {
+        result.add_magnitude(y);
+    }
+    else if (compare_magnitude(y) >= 0) {
+        result.subtract_magnitude(y);
+    }
+    else {
+        result = y;
+        result.subtract_magnitude(*this);
+    }
+    if (result.is_zero()) {
+        result.m_negative = false;
+    }
+    return result;
+}
+
+FixedPoint FixedPoint::operator-(const FixedPoint& y) const {
+    FixedPoint negated(y);
+    negated.m_negative = !y.m_negative && !y.is_zero();
+    return *this + negated;
+}
+
+// Description:
+// Schoolbook product of the two magnitudes into 2n limbs, keeping limbs n-1 to 2n-2:
+// the product has twice the fraction bits, and its top limb is an integer overflow
+// that cannot happen for the |z| < 2^16 values of an orbit.
+FixedPoint FixedPoint::operator*(const FixedPoint& y) const {
+    assert(limbs() == y.limbs());
+    const int n = limbs();
+    std::vector<unsigned int> product(2 * n, 0u);
+    for (int i = 0; i < n; ++i) {
+        if (!m_limbs[i]) {
+            continue;
+        }
+        unsigned long long carry = 0;
+        for (int j = 0; j < n; ++j) {
+            unsigned long long t = static_cast<unsigned long long>(m_limbs[i]) * y.m_limbs[j] + product[i + j] + carry;
+            product[i + j] = static_cast<unsigned int>(t);
+            carry = t >> 32;
+        }
+        product[i + n] = static_cast<unsigned int>(carry);
+    }
+    FixedPoint result(n);
+    for (int k = 0; k < n; ++k) {
+        result.m_limbs[k] = product[k + n - 1];
+    }
+    result.m_negative = (m_negative != y.m_negative) && !result.is_zero();
+    return result;
+}
@@ -0,0 +1,61 @@
+//==============================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2010-2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ===============================================================
+
+// Signed fixed point numbers with a runtime number of 32-bit limbs.
+// The most significant limb holds the integer part, the others the fraction, so a number
+// with n limbs has 32 * (n - 1) fraction bits and an integer part below 2^32.
+// Only what the perturbation reference orbit needs is provided: +, -, * and
+// conversions from decimal strings and to/from double.
+
+#ifndef MULTIPRECISION_H
+#define MULTIPRECISION_H
+
+#include <string>
+#include <vector>
+
+class FixedPoint {
+public:
+    // Zero with the given number of limbs
+    explicit FixedPoint(int limbs);
+    FixedPoint(int limbs, double value);
+    // Parses an optionally signed decimal number such as "-0.743643887037158704752191506114774"
+    FixedPoint(int limbs, const std::string& decimal);
+
+    inline int limbs() const {
+        return static_cast<int>(m_limbs.size());
+    }
+
+    double to_double() const;
+
+    FixedPoint operator+(const FixedPoint& y) const;
+    FixedPoint operator-(const FixedPoint& y) const;
+    FixedPoint operator*(const FixedPoint& y) const;
+
+    // Number of limbs needed to resolve steps of the given size, with 64 guard bits
+    static int limbs_for(double step);
+
+private:
+    // Limbs in little-endian order: m_limbs[0] is the least significant fraction limb
+    std::vector<unsigned int> m_limbs;
+    bool m_negative;
+
+    // |this| compared with |y|: negative, zero or positive
+    int compare_magnitude(const FixedPoint& y) const;
+    // |this| += |y|
+    void add_magnitude(const FixedPoint& y);
+    // |this| -= |y|, assuming |this| >= |y|
+    void subtract_magnitude(const FixedPoint& y);
+    bool is_zero() const;
+};
+
+#endif // MULTIPRECISION_H
@@ -0,0 +1,146 @@
+//==============================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2010-2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ===============================================================
+
+// The orbits here start from z_0 = 0, one step before the z_0 = c of cilk_mandelbrot,
+// which makes Z_0 = 0 for the reference and lets a pixel rebase with d = z exactly.
+//
+// Glitches happen where the pixel orbit passes closer to 0 than to the reference orbit:
+// d_n then carries all of z_n and the small Z_n it is added to has lost the precision
+// the pixel needs. Each pixel checks |z_n| < |d_n| at every step, and on detection rebases
+// itself onto the start of the reference orbit (d = z, n = 0), which is exact since Z_0 = 0.
+// The same rebase lets a pixel outlive a reference orbit that escaped early.
+// Rebasing is local to the pixel, so it runs in parallel with everything else and never
+// needs a second reference orbit.
+
+#include "perturbation.h"
+#include "mandelbrot.h"
+#include "multiprecision.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <cilk/cilk.h>
+#include <cilk/reducer_opadd.h>
+
+#include <emmintrin.h>
+
+// Description:
+// Computes the reference orbit Z_0 = 0, Z_n+1 = Z_n^2 + C in fixed point, rounded to doubles.
+// The orbit stops after max_depth steps or right after it escapes.
+//
+// [in]: center_real, center_imaginary, limbs, max_depth
+// [out]: reference_real, reference_imaginary (index of the last element is the orbit length)
+static void reference_orbit(const std::string& center_real, const std::string& center_imaginary, int limbs,
+                            int max_depth, std::vector<double>& reference_real, std::vector<double>& reference_imaginary) {
+  const FixedPoint c_real(limbs, center_real);
+  const FixedPoint c_imaginary(limbs, center_imaginary);
+  FixedPoint z_real(limbs), z_imaginary(limbs);
+  reference_real.assign(1, 0.0);
+  reference_imaginary.assign(1, 0.0);
+  for (int n = 0; n < max_depth; ++n) {
+    FixedPoint zr2 = z_real * z_real;
+    FixedPoint zi2 = z_imaginary * z_imaginary;
+    FixedPoint zri = z_real * z_imaginary;
+    z_real = zr2 - zi2 + c_real;
+    z_imaginary = zri + zri + c_imaginary;
+    double zr = z_real.to_double();
+    double zi = z_imaginary.to_double();
+    reference_real.push_back(zr);
+    reference_imaginary.push_back(zi);
+    if (zr * zr + zi * zi > 4.0) {
+      break;
+    }
+  }
+}
+
+// Description:
+// Iterates the difference between a pixel orbit and the reference orbit, rebasing onto the
+// start of the reference when the pixel glitches or reaches the end of the reference orbit.
+//
+// [in]: reference_real, reference_imaginary, reference_length, dc_real, dc_imaginary, max_depth
+// [out]: depth, as in cilk_mandelbrot; rebases is incremented by the number of rebases
+static double perturbed_depth(const double* reference_real, const double* reference_imaginary, int reference_length,
+                              double dc_real, double dc_imaginary, int max_depth, long long& rebases) {
+  double d_real = 0;
+  double d_imaginary = 0;
+  int n = 0;
+  // Step m computes z_m, which is z_m-1 in the numbering of cilk_mandelbrot
+  for (int m = 1; m <= max_depth; ++m) {
+    double temp_real = 2.0*(reference_real[n]*d_real - reference_imaginary[n]*d_imaginary)
+                       + (d_real*d_real - d_imaginary*d_imaginary) + dc_real;
+    double temp_imaginary = 2.0*(reference_real[n]*d_imaginary + reference_imaginary[n]*d_real)
+                            + 2.0*d_real*d_imaginary + dc_imaginary;
+    d_real = temp_real;
+    d_imaginary = temp_imaginary;
+    ++n;
+
+    double z_real = reference_real[n] + d_real;
+    double z_imaginary = reference_imaginary[n] + d_imaginary;
+    double magnitude = z_real*z_real + z_imaginary*z_imaginary;
+    if (magnitude > 4.0) {
+      return m - 1; // Escape from a circle of radius 2
+    }
+    if (magnitude < d_real*d_real + d_imaginary*d_imaginary || n == reference_length) {
+      d_real = z_real;
+      d_imaginary = z_imaginary;
+      n = 0;
+      ++rebases;
+    }
+  }
+  return max_depth;
+}
+
+// Description:
+// Computes the reference orbit at the center of the image, then every pixel as a perturbation
+// of it, over 2D tiles scheduled with cilk_for.
+//
+// [in]: center_real, center_imaginary, span, width, height, max_depth
+// [out]: output (caller must deallocate), stats (optional)
+unsigned char* perturbation_mandelbrot(const std::string& center_real, const std::string& center_imaginary,
+                                       double span, int width, int height, int max_depth,
+                                       PerturbationStats* stats) {
+  const double step = span / width;
+  const int limbs = FixedPoint::limbs_for(step);
+  std::vector<double> reference_real, reference_imaginary;
+  reference_orbit(center_real, center_imaginary, limbs, max_depth, reference_real, reference_imaginary);
+  const int reference_length = static_cast<int>(reference_real.size()) - 1;
+
+  unsigned char* output = static_cast<unsigned char*>(_mm_malloc(width * height * sizeof(unsigned char), 64));
+  const double dc_real0 = -0.5 * width * step;
+  const double dc_imaginary0 = -0.5 * height * step;
+  cilk::reducer<cilk::op_add<long long> > rebases;
+  int tiles_x = (width + MANDELBROT_TILE_WIDTH - 1) / MANDELBROT_TILE_WIDTH;
+  int tiles_y = (height + MANDELBROT_TILE_HEIGHT - 1) / MANDELBROT_TILE_HEIGHT;
+  cilk_for(int t = 0; t < tiles_x * tiles_y; ++t) {
+    int tile_x = (t % tiles_x) * MANDELBROT_TILE_WIDTH;
+    int tile_y = (t / tiles_x) * MANDELBROT_TILE_HEIGHT;
+    int i_end = std::min(tile_x + MANDELBROT_TILE_WIDTH, width);
+    int j_end = std::min(tile_y + MANDELBROT_TILE_HEIGHT, height);
+    long long tile_rebases = 0;
+    for (int j = tile_y; j < j_end; ++j) {
+      for (int i = tile_x; i < i_end; ++i) {
+        double depth = perturbed_depth(&reference_real[0], &reference_imaginary[0], reference_length,
+                                       dc_real0 + i*step, dc_imaginary0 + j*step, max_depth, tile_rebases);
+        output[j*width + i] = static_cast<unsigned char>(depth / max_depth * 255);
+      }
+    }
+    *rebases += tile_rebases;
+  }
+
+  if (stats) {
+    stats->limbs = limbs;
+    stats->reference_length = reference_length;
+    stats->rebases = rebases.get_value();
+  }
+  return output;
+}
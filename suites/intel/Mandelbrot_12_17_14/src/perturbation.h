@@ -0,0 +1,39 @@
+//==============================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2010-2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ===============================================================
+
+// Deep zoom Mandelbrot renderer based on perturbation theory.
+// A single reference orbit Z_n is computed in multi-precision at the center of the image,
+// and every pixel c = C + dc iterates only its difference d_n = z_n - Z_n in double precision:
+//     d_n+1 = 2 Z_n d_n + d_n^2 + dc
+// Plain doubles stop resolving neighbouring pixels around 1e-13 zoom; the differences do not.
+
+#ifndef PERTURBATION_H
+#define PERTURBATION_H
+
+#include <string>
+
+// What happened while rendering a perturbation image
+struct PerturbationStats {
+  int limbs;              // 32-bit limbs used by the reference orbit
+  int reference_length;   // iterations of the reference orbit before it escaped, or max_depth
+  long long rebases;      // times a pixel was moved back to the start of the reference orbit
+};
+
+// Same depth mapping as cilk_mandelbrot, for the image of width x height square pixels
+// centered on (center_real, center_imaginary) and span wide. The center is given as decimal
+// strings, so it can carry more digits than a double.
+unsigned char* perturbation_mandelbrot(const std::string& center_real, const std::string& center_imaginary,
+                                       double span, int width, int height, int max_depth,
+                                       PerturbationStats* stats = 0);
+
+#endif // PERTURBATION_H
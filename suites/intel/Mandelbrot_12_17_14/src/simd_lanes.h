@@ -0,0 +1,178 @@
+//==============================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2010-2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ===============================================================
+
+// Thin wrappers over the double precision SIMD registers of the target.
+// A "lane group" is one register worth of pixels: 8 with AVX-512, 4 with AVX and 2 with SSE2.
+// Each lane carries its own escape mask, so the kernels built on top of these wrappers
+// stop iterating a lane as soon as its point leaves the circle of radius 2, and stop
+// the whole group once every lane has escaped.
+//
+// The comparisons are the negation of the scalar "> 4.0" test, and no fused multiply-add
+// is used, so a lane computes exactly the same depth as the scalar loop in cilk_mandelbrot.
+
+#ifndef SIMD_LANES_H
+#define SIMD_LANES_H
+
+#include <immintrin.h>
+
+namespace simd {
+
+#if defined(__AVX512F__)
+
+const int LANES = 8;
+typedef __m512d vdouble;
+typedef __mmask8 vmask;
+
+inline vdouble set1(double x) { return _mm512_set1_pd(x); }
+inline vdouble ramp() { return _mm512_set_pd(7.0, 6.0, 5.0, 4.0, 3.0, 2.0, 1.0, 0.0); }
+inline vdouble add(vdouble a, vdouble b) { return _mm512_add_pd(a, b); }
+inline vdouble sub(vdouble a, vdouble b) { return _mm512_sub_pd(a, b); }
+inline vdouble mul(vdouble a, vdouble b) { return _mm512_mul_pd(a, b); }
+inline vmask all_lanes() { return vmask(0xff); }
+// Lanes of @p active whose @p a is not greater than @p b
+inline vmask not_greater(vdouble a, vdouble b, vmask active) { return _mm512_mask_cmp_pd_mask(active, a, b, _CMP_NGT_UQ); }
+inline bool any(vmask m) { return m != 0; }
+// Adds @p inc to the lanes of @p a selected by @p m
+inline vdouble add_masked(vdouble a, vdouble inc, vmask m) { return _mm512_mask_add_pd(a, m, a, inc); }
+// Lanes of @p active where @p a equals @p b exactly
+inline vmask equal(vdouble a, vdouble b, vmask active) { return _mm512_mask_cmp_pd_mask(active, a, b, _CMP_EQ_OQ); }
+inline vmask both(vmask a, vmask b) { return a & b; }
+// Lanes of @p a not in @p b
+inline vmask clear(vmask a, vmask b) { return a & ~b; }
+// @p b in the lanes selected by @p m, @p a elsewhere
+inline vdouble blend(vdouble a, vdouble b, vmask m) { return _mm512_mask_mov_pd(a, m, b); }
+inline void store(double* p, vdouble a) { _mm512_storeu_pd(p, a); }
+
+#elif defined(__AVX__)
+
+const int LANES = 4;
+typedef __m256d vdouble;
+typedef __m256d vmask;
+
+inline vdouble set1(double x) { return _mm256_set1_pd(x); }
+inline vdouble ramp() { return _mm256_set_pd(3.0, 2.0, 1.0, 0.0); }
+inline vdouble add(vdouble a, vdouble b) { return _mm256_add_pd(a, b); }
+inline vdouble sub(vdouble a, vdouble b) { return _mm256_sub_pd(a, b); }
+inline vdouble mul(vdouble a, vdouble b) { return _mm256_mul_pd(a, b); }
+inline vmask all_lanes() { return _mm256_castsi256_pd(_mm256_set1_epi64x(-1)); }
+inline vmask not_greater(vdouble a, vdouble b, vmask active) { return _mm256_and_pd(active, _mm256_cmp_pd(a, b, _CMP_NGT_UQ)); }
+inline bool any(vmask m) { return _mm256_movemask_pd(m) != 0; }
+inline vdouble add_masked(vdouble a, vdouble inc, vmask m) { return _mm256_add_pd(a, _mm256_and_pd(inc, m)); }
+inline vmask equal(vdouble a, vdouble b, vmask active) { return _mm256_and_pd(active, _mm256_cmp_pd(a, b, _CMP_EQ_OQ)); }
+inline vmask both(vmask a, vmask b) { return _mm256_and_pd(a, b); }
+inline vmask clear(vmask a, vmask b) { return _mm256_andnot_pd(b, a); }
+inline vdouble blend(vdouble a, vdouble b, vmask m) { return _mm256_blendv_pd(a, b, m); }
+inline void store(double* p, vdouble a) { _mm256_storeu_pd(p, a); }
+
+#else
+
+const int LANES = 2;
+typedef __m128d vdouble;
+typedef __m128d vmask;
+
+inline vdouble set1(double x) { return _mm_set1_pd(x); }
+inline vdouble ramp() { return _mm_set_pd(1.0, 0.0); }
+inline vdouble add(vdouble a, vdouble b) { return _mm_add_pd(a, b); }
+inline vdouble sub(vdouble a, vdouble b) { return _mm_sub_pd(a, b); }
+inline vdouble mul(vdouble a, vdouble b) { return _mm_mul_pd(a, b); }
+inline vmask all_lanes() { return _mm_castsi128_pd(_mm_set1_epi64x(-1)); }
+inline vmask not_greater(vdouble a, vdouble b, vmask active) { return _mm_and_pd(active, _mm_cmpngt_pd(a, b)); }
+inline bool any(vmask m) { return _mm_movemask_pd(m) != 0; }
+inline vdouble add_masked(vdouble a, vdouble inc, vmask m) { return _mm_add_pd(a, _mm_and_pd(inc, m)); }
+inline vmask equal(vdouble a, vdouble b, vmask active) { return _mm_and_pd(active, _mm_cmpeq_pd(a, b)); }
+inline vmask both(vmask a, vmask b) { return _mm_and_pd(a, b); }
+inline vmask clear(vmask a, vmask b) { return _mm_andnot_pd(b, a); }
+inline vdouble blend(vdouble a, vdouble b, vmask m) { return _mm_or_pd(_mm_andnot_pd(m, a), _mm_and_pd(m, b)); }
+inline void store(double* p, vdouble a) { _mm_storeu_pd(p, a); }
+
+#endif
+
+// Description:
+// Iterates z_n+1 = z_n^2 + c for one lane group, up to max_depth, with a per-lane escape mask.
+// The loop exits early once every lane has escaped.
+//
+// [in]: c_real, c_imaginary, max_depth
+// [out]: depth of each lane, as in the scalar loop
+inline vdouble escape_depth(vdouble c_real, vdouble c_imaginary, int max_depth) {
+  const vdouble four = set1(4.0);
+  const vdouble two = set1(2.0);
+  const vdouble one = set1(1.0);
+  vdouble z_real = c_real;
+  vdouble z_imaginary = c_imaginary;
+  vdouble depth = set1(0.0);
+  vmask active = all_lanes();
+  for (int iteration = 0; iteration < max_depth; ++iteration) {
+    vdouble zr2 = mul(z_real, z_real);
+    vdouble zi2 = mul(z_imaginary, z_imaginary);
+    active = not_greater(add(zr2, zi2), four, active);
+    if (!any(active)) {
+      break; // Every lane escaped from the circle of radius 2
+    }
+    vdouble temp_imaginary = mul(mul(two, z_real), z_imaginary);
+    z_real = add(c_real, sub(zr2, zi2));
+    z_imaginary = add(c_imaginary, temp_imaginary);
+    depth = add_masked(depth, one, active);
+  }
+  return depth;
+}
+
+// Description:
+// Same as escape_depth, with a periodicity check for interior points.
+// The orbit of every lane is saved at iterations 1, 2, 4, 8, ... (Brent's cycle detection; the
+// iteration count is the same for all lanes), and a lane whose z comes back exactly to its saved
+// value is periodic: it can never escape, so it gets max_depth at once.
+// The comparison is exact, so the depths are still those of the scalar loop.
+//
+// [in]: c_real, c_imaginary, max_depth
+// [out]: depth of each lane, as in the scalar loop
+inline vdouble escape_depth_periodic(vdouble c_real, vdouble c_imaginary, int max_depth) {
+  const vdouble four = set1(4.0);
+  const vdouble two = set1(2.0);
+  const vdouble one = set1(1.0);
+  const vdouble deepest = set1(max_depth);
+  vdouble z_real = c_real;
+  vdouble z_imaginary = c_imaginary;
+  vdouble saved_real = z_real;
+  vdouble saved_imaginary = z_imaginary;
+  vdouble depth = set1(0.0);
+  vmask active = all_lanes();
+  int next_save = 1;
+  for (int iteration = 0; iteration < max_depth; ++iteration) {
+    vdouble zr2 = mul(z_real, z_real);
+    vdouble zi2 = mul(z_imaginary, z_imaginary);
+    active = not_greater(add(zr2, zi2), four, active);
+    if (!any(active)) {
+      break;
+    }
+    vdouble temp_imaginary = mul(mul(two, z_real), z_imaginary);
+    z_real = add(c_real, sub(zr2, zi2));
+    z_imaginary = add(c_imaginary, temp_imaginary);
+    depth = add_masked(depth, one, active);
+
+    vmask periodic = both(equal(z_real, saved_real, active), equal(z_imaginary, saved_imaginary, active));
+    if (any(periodic)) {
+      depth = blend(depth, deepest, periodic);
+      active = clear(active, periodic);
+    }
+    if (iteration + 1 == next_save) {
+      saved_real = z_real;
+      saved_imaginary = z_imaginary;
+      next_save *= 2;
+    }
+  }
+  return depth;
+}
+
+} // namespace simd
+
+#endif // SIMD_LANES_H
@@ -0,0 +1,202 @@
+//==============================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2010-2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ===============================================================
+
+#include "valsig.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <emmintrin.h>
+#include <cilk/cilk.h>
+#include <cilk/cilk_api.h>
+
+using namespace io;
+
+// Sum of n bytes, 16 at a time with psadbw
+static unsigned sum_bytes(const unsigned char* p, unsigned int n) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    unsigned int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)), zero));
+    }
+    unsigned long long lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+    unsigned long long sum = lanes[0] + lanes[1];
+    for (; i < n; ++i) {
+        sum += p[i];
+    }
+    return static_cast<unsigned>(sum);
+}
+
+void ValidationSignature::compute(const unsigned char* image, unsigned int image_width, unsigned int image_height,
+                                  unsigned int channels) {
+    assert(channels <= VALSIG_CHANNELS);
+    width = image_width;
+    height = image_height;
+    rows.assign(height * VALSIG_CHANNELS, 0);
+    columns.assign(width * VALSIG_CHANNELS, 0);
+    const unsigned int row_bytes = width * channels;
+
+    // Column sums of the rows each worker summed, in the layout of a row of the image.
+    // A worker only touches its own vector, which it allocates the first time it needs it
+    std::vector<std::vector<unsigned> > partial(__cilkrts_get_nworkers());
+
+    const int tasks = int((height + VALSIG_ROWS_PER_TASK - 1) / VALSIG_ROWS_PER_TASK);
+    cilk_for (int t = 0; t < tasks; ++t) {
+        std::vector<unsigned>& colsum = partial[__cilkrts_get_worker_number()];
+        if (colsum.empty()) {
+            colsum.assign(row_bytes, 0);
+        }
+        unsigned int end = std::min(height, (t + 1) * VALSIG_ROWS_PER_TASK);
+        for (unsigned int y = t * VALSIG_ROWS_PER_TASK; y < end; ++y) {
+            const unsigned char* row = image + size_t(y) * row_bytes;
+            if (channels == 1) {
+                rows[y * VALSIG_CHANNELS] = sum_bytes(row, width);
+            }
+            else {
+                for (unsigned int x = 0; x < width; ++x) {
+                    for (unsigned int k = 0; k < channels; ++k) {
+                        rows[y * VALSIG_CHANNELS + k] += row[x * channels + k];
+                    }
+                }
+            }
+            for (unsigned int i = 0; i < row_bytes; ++i) {
+                colsum[i] += row[i];
+            }
+        }
+    }
+
+    cilk_for (unsigned int x = 0; x < width; ++x) {
+        for (size_t w = 0; w < partial.size(); ++w) {
+            if (!partial[w].empty()) {
+                for (unsigned int k = 0; k < channels; ++k) {
+                    columns[x * VALSIG_CHANNELS + k] += partial[w][x * channels + k];
+                }
+            }
+        }
+    }
+}
+
+// Appends the decimal digits of value
+static void append_number(std::string& text, unsigned value) {
+    char digits[16];
+    int n = 0;
+    do {
+        digits[n++] = char('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    while (n > 0) {
+        text += digits[--n];
+    }
+}
+
+static void append_sums(std::string& text, const std::vector<unsigned>& sums) {
+    for (size_t i = 0; i < sums.size(); i += VALSIG_CHANNELS) {
+        append_number(text, sums[i]);
+        for (unsigned int k = 1; k < VALSIG_CHANNELS; ++k) {
+            text += ' ';
+            append_number(text, sums[i + k]);
+        }
+        text += '\n';
+    }
+}
+
+static bool write_file(const std::string& filename, const std::string& text) {
+    FILE* file = fopen(filename.c_str(), "w");
+    if (file == NULL) {
+        return false;
+    }
+    bool good = fwrite(text.data(), 1, text.size(), file) == text.size();
+    return fclose(file) == 0 && good;
+}
+
+bool ValidationSignature::save(const std::string& filename) const {
+    std::string text;
+    // Every sum is at most 10 digits and a separator
+    text.reserve((rows.size() + columns.size()) * 11 + 64);
+    text += "Frame 0 rows\n";
+    append_sums(text, rows);
+    text += "Frame 0 columns\n";
+    append_sums(text, columns);
+    return write_file(filename, text);
+}
+
+unsigned long long ValidationSignature::digest() const {
+    unsigned long long hash = 14695981039346656037ULL;
+    const unsigned long long prime = 1099511628211ULL;
+    unsigned size[2] = { width, height };
+    const unsigned* arrays[3] = { size, rows.empty() ? 0 : &rows[0], columns.empty() ? 0 : &columns[0] };
+    const size_t counts[3] = { 2, rows.size(), columns.size() };
+    for (int a = 0; a < 3; ++a) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(arrays[a]);
+        for (size_t i = 0; i < counts[a] * sizeof(unsigned); ++i) {
+            hash = (hash ^ bytes[i]) * prime;
+        }
+    }
+    return hash;
+}
+
+bool ValidationSignature::save_digest(const std::string& filename) const {
+    char line[64];
+    snprintf(line, sizeof(line), "valsig %ux%u %016llx\n", width, height, digest());
+    return write_file(filename, line);
+}
+
+static bool read_lines(const std::string& filename, std::vector<std::string>& lines) {
+    std::ifstream file(filename.c_str());
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        lines.push_back(line);
+    }
+    return true;
+}
+
+int io::compare_valsig(const std::string& filename_a, const std::string& filename_b) {
+    // Differences printed before only the count is reported
+    const int max_printed = 10;
+    std::vector<std::string> a, b;
+    if (!read_lines(filename_a, a) || !read_lines(filename_b, b)) {
+        std::cout << "Could not read " << filename_a << " or " << filename_b << std::endl;
+        return -1;
+    }
+
+    int differences = 0;
+    std::string section = "line";
+    int index = 0;
+    for (size_t i = 0; i < std::max(a.size(), b.size()); ++i) {
+        const std::string& line_a = i < a.size() ? a[i] : std::string("<missing>");
+        const std::string& line_b = i < b.size() ? b[i] : std::string("<missing>");
+        if (line_a.compare(0, 5, "Frame") == 0) {
+            section = line_a.substr(line_a.rfind(' ') + 1);
+            index = 0;
+        }
+        else {
+            ++index;
+        }
+        if (line_a != line_b) {
+            if (differences < max_printed) {
+                std::cout << section << " " << index - 1 << ": " << line_a << " | " << line_b << std::endl;
+            }
+            ++differences;
+        }
+    }
+    std::cout << differences << " differences" << std::endl;
+    return differences;
+}
@@ -0,0 +1,59 @@
+//==============================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2010-2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ===============================================================
+
+// Validation signatures of images: the sum of every row and every column, per channel.
+// A signature is linear in width+height, so two runs can be compared without keeping the images.
+// It is saved either as text (one line per row and per column) or as a one line hex digest.
+
+#ifndef VALSIG_H
+#define VALSIG_H
+
+#include <string>
+#include <vector>
+
+namespace io {
+
+// Channels written per row and column; missing channels are written as 0
+const unsigned int VALSIG_CHANNELS = 3;
+
+// Rows summed by one iteration of the parallel loop
+const unsigned int VALSIG_ROWS_PER_TASK = 64;
+
+struct ValidationSignature {
+    unsigned int width, height;
+    // VALSIG_CHANNELS sums per row, then per column
+    std::vector<unsigned> rows;
+    std::vector<unsigned> columns;
+
+    // Sums the rows and columns of image, which has channels interleaved channels.
+    // Row blocks are summed in parallel; the column sums are accumulated per worker and added at the end
+    void compute(const unsigned char* image, unsigned int width, unsigned int height, unsigned int channels);
+    // Text signature, as "Frame 0 rows", one line per row, "Frame 0 columns", one line per column
+    bool save(const std::string& filename) const;
+    // 64 bit FNV-1a hash of the size and of every sum
+    unsigned long long digest() const;
+    // One line: "valsig <width>x<height> <digest in hex>"
+    bool save_digest(const std::string& filename) const;
+};
+
+// Description:
+// Compares two signature files, both text or both digests.
+// Prints the first differing lines and the number of differences.
+//
+// [in]: filename_a, filename_b
+// [out]: number of differing lines, 0 if the signatures match, -1 if a file cannot be read
+int compare_valsig(const std::string& filename_a, const std::string& filename_b);
+
+} // namespace io
+
+#endif // VALSIG_H
@@ -0,0 +1,90 @@
+//==============================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2010-2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ===============================================================
+
+// The sequence is a two stage pipeline. The encode/write of frame k is spawned with cilk_spawn,
+// and the continuation, which computes frame k+1, is stolen by the other workers while
+// the spawning worker writes. The cilk_sync before the next spawn bounds the pipeline
+// to one outstanding write, so ZOOM_POOL_SIZE = 2 frame buffers are enough.
+
+#include "zoom_sequence.h"
+#include "mandelbrot.h"
+#include "bmp_image.h"
+#include "timer.h"
+
+#include <cmath>
+#include <cstdio>
+#include <memory>
+
+#include <cilk/cilk.h>
+
+#include <emmintrin.h>
+
+// One reusable frame: the computed depths, and the 8 bit image that wraps them for saving
+struct FrameSlot {
+  unsigned char* pixels;
+  std::unique_ptr<io::BMPImage> image;
+};
+
+// Description:
+// Encodes a computed frame as a BMP file
+//
+// [in]: slot, filename
+static void write_frame(FrameSlot* slot, std::string filename) {
+  slot->image->save(filename);
+}
+
+// Description:
+// Renders the frames of the zoom path, overlapping the write of each frame with the
+// computation of the next one. The cost map of adaptive_mandelbrot_frame is taken from the
+// previous frame, which is close to the current one when the zoom scale is close to 1.
+//
+// [in]: path, width, height, max_depth, prefix
+// [out]: seconds taken by the whole sequence
+double render_zoom_sequence(const ZoomPath& path, int width, int height, int max_depth,
+                            const std::string& prefix) {
+  FrameSlot pool[ZOOM_POOL_SIZE];
+  for (int s = 0; s < ZOOM_POOL_SIZE; ++s) {
+    pool[s].pixels = static_cast<unsigned char*>(_mm_malloc(width * height * sizeof(unsigned char), 64));
+    pool[s].image.reset(new io::BMPImage(width, height, 8));
+    pool[s].image->wrap(pool[s].pixels);
+  }
+  MandelbrotCostMap costs;
+  bool have_costs = false;
+
+  CUtilTimer timer;
+  timer.start();
+  for (int k = 0; k < path.frames; ++k) {
+    FrameSlot& slot = pool[k % ZOOM_POOL_SIZE];
+    double zoom = std::pow(path.scale, k);
+    adaptive_mandelbrot_frame(path.center_x + (path.x0 - path.center_x) * zoom,
+                              path.center_y + (path.y0 - path.center_y) * zoom,
+                              path.center_x + (path.x1 - path.center_x) * zoom,
+                              path.center_y + (path.y1 - path.center_y) * zoom,
+                              width, height, max_depth, slot.pixels, have_costs ? &costs : 0);
+    // Frame k-1 is written once this returns, so its slot can take frame k+1
+    cilk_sync;
+    mandelbrot_cost_from_frame(slot.pixels, width, height, costs);
+    have_costs = true;
+
+    char filename[64];
+    snprintf(filename, sizeof(filename), "_%04d.bmp", k);
+    cilk_spawn write_frame(&slot, prefix + filename);
+  }
+  cilk_sync;
+  timer.stop();
+
+  for (int s = 0; s < ZOOM_POOL_SIZE; ++s) {
+    _mm_free(pool[s].pixels);
+  }
+  return timer.get_time();
+}
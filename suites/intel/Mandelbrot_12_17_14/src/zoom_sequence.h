@@ -0,0 +1,39 @@
+//==============================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2010-2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ===============================================================
+
+// Renders a zoom into the Mandelbrot set as a sequence of BMP frames.
+// Writing frame k to disk overlaps with the computation of frame k+1.
+
+#ifndef ZOOM_SEQUENCE_H
+#define ZOOM_SEQUENCE_H
+
+#include <string>
+
+// A zoom path: the first frame is the rectangle (x0, y0) - (x1, y1), and every following frame
+// is the previous one scaled by scale around the fixed point (center_x, center_y)
+struct ZoomPath {
+  double x0, y0, x1, y1;
+  double center_x, center_y;
+  double scale;
+  int frames;
+};
+
+// Number of frame buffers reused across the sequence: one being computed, one being written
+const int ZOOM_POOL_SIZE = 2;
+
+// Renders every frame of path with adaptive_mandelbrot_frame and saves frame k as
+// <prefix>_<k>.bmp. Returns the number of seconds taken by the whole sequence, I/O included.
+double render_zoom_sequence(const ZoomPath& path, int width, int height, int max_depth,
+                            const std::string& prefix);
+
+#endif // ZOOM_SEQUENCE_H
@@ -30,6 +30,12 @@
 #endif
 
 #include "SepiaFilterCilkPlus.h"
+#include "bmp_io.h"
+#include "batch_pipeline.h"
+#include "planar.h"
+#include "color_transform.h"
+#include <emmintrin.h>
+#include <string.h>
 #define ALIGNMENT 32 //Set to 16 bytes for SSE architectures and 32 bytes for Intel(R) AVX architectures
 using namespace std;
 
@@ -47,6 +53,221 @@ void process_image_AOS(rgb &indataset, rgb &outdataset){
 }
 
 
+// Pixels filtered by one iteration of the cilk_for of process_image_SOA_cilk_for
+#define SOA_CHUNK 4096
+
+// Description:
+// Sepia tone of count pixels stored as planes, 16 pixels at a time: the bytes are widened to
+// four vectors of 4 floats per channel, and the products are added in the same order as in
+// process_image_AOS, so the results are the same. Truncation to int then the saturating packs
+// to 16 and 8 bits do the clamp to 255.
+//
+// [in]: blue, green, red, count
+// [out]: out_blue, out_green, out_red
+static void process_planes(const unsigned char *blue, const unsigned char *green, const unsigned char *red,
+						   unsigned char *out_blue, unsigned char *out_green, unsigned char *out_red, int count){
+	static const float coefficients[3][3] = {
+		{0.393f, 0.769f, 0.189f},
+		{0.349f, 0.686f, 0.168f},
+		{0.272f, 0.534f, 0.131f}
+	};
+	unsigned char *outputs[3] = { out_red, out_green, out_blue };
+	const __m128i zero = _mm_setzero_si128();
+	int i = 0;
+	for(; i + 16 <= count; i += 16)
+	{
+		__m128i planes[3] = {
+			_mm_loadu_si128((const __m128i *)(red + i)),
+			_mm_loadu_si128((const __m128i *)(green + i)),
+			_mm_loadu_si128((const __m128i *)(blue + i))
+		};
+		// Channel c of pixels 4q to 4q+3, as floats
+		__m128 values[3][4];
+		for(int c = 0; c < 3; c++)
+		{
+			__m128i low = _mm_unpacklo_epi8(planes[c], zero), high = _mm_unpackhi_epi8(planes[c], zero);
+			values[c][0] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero));
+			values[c][1] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero));
+			values[c][2] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero));
+			values[c][3] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero));
+		}
+		for(int o = 0; o < 3; o++)
+		{
+			__m128i result[4];
+			for(int q = 0; q < 4; q++)
+			{
+				__m128 temp = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(coefficients[o][0]), values[0][q]),
+													_mm_mul_ps(_mm_set1_ps(coefficients[o][1]), values[1][q])),
+										 _mm_mul_ps(_mm_set1_ps(coefficients[o][2]), values[2][q]));
+				result[q] = _mm_cvttps_epi32(temp);
+			}
+			__m128i packed = _mm_packus_epi16(_mm_packs_epi32(result[0], result[1]), _mm_packs_epi32(result[2], result[3]));
+			_mm_storeu_si128((__m128i *)(outputs[o] + i), packed);
+		}
+	}
+	for(; i < count; i++)
+	{
+		rgb pixel = { blue[i], green[i], red[i] }, result;
+		process_image_AOS(pixel, result);
+		out_blue[i] = result.blue;
+		out_green[i] = result.green;
+		out_red[i] = result.red;
+	}
+}
+
+// Description:
+// Sepia tone of an image split in blue, green and red planes, one SOA_CHUNK of pixels per cilk_for iteration.
+//
+// [in]: indataset, size_of_image
+// [out]: outdataset
+#if defined(_WIN32)
+__declspec(noinline) 
+#else
+__attribute__ ((noinline))
+#endif
+void process_image_SOA_cilk_for(const SOA_rgb &indataset, const SOA_rgb &outdataset, int size_of_image){
+	int chunks = (size_of_image + SOA_CHUNK - 1)/SOA_CHUNK;
+	cilk_for(int k = 0; k < chunks; k++)
+	{
+		int first = k*SOA_CHUNK;
+		int count = (first + SOA_CHUNK < size_of_image) ? SOA_CHUNK : size_of_image - first;
+		process_planes(indataset.blue + first, indataset.green + first, indataset.red + first,
+					   outdataset.blue + first, outdataset.green + first, outdataset.red + first, count);
+	}
+}
+
+// Fixed-point version: the coefficients scaled by 2^FIXED_SHIFT and rounded, as 16 bit integers
+#define FIXED_SHIFT 14
+// Pixels filtered by one iteration of the cilk_for of process_image_fixed_cilk_for
+#define FIXED_CHUNK 4096
+// Pixels converted to planes at once on the stack, small enough to stay in L1
+#define FIXED_BLOCK 256
+
+// Description:
+// Fixed-point sepia tone of count pixels stored as planes, 16 at a time. The channels are widened to
+// 16 bits and interleaved in (red, green) and (blue, 0) pairs, so that one pmaddwd per pair gives
+// c0*red + c1*green and c2*blue for 4 pixels in 32 bit lanes. The sum is shifted back, truncated as
+// the float version is, and the saturating packs clamp it to 255.
+// The error of the rounded coefficients is below 765/2^15 < 0.03, so every output is within
+// 1 of process_image_AOS.
+//
+// [in]: blue, green, red, count
+// [out]: out_blue, out_green, out_red
+static void process_planes_fixed(const unsigned char *blue, const unsigned char *green, const unsigned char *red,
+								 unsigned char *out_blue, unsigned char *out_green, unsigned char *out_red, int count){
+	static const short coefficients[3][3] = {
+		{6439, 12599, 3097},  // 0.393, 0.769, 0.189
+		{5718, 11239, 2753},  // 0.349, 0.686, 0.168
+		{4456, 8749, 2146}    // 0.272, 0.534, 0.131
+	};
+	unsigned char *outputs[3] = { out_red, out_green, out_blue };
+	const __m128i zero = _mm_setzero_si128();
+	__m128i red_green[3], blue_zero[3];
+	for(int o = 0; o < 3; o++)
+	{
+		red_green[o] = _mm_set_epi16(coefficients[o][1], coefficients[o][0], coefficients[o][1], coefficients[o][0],
+									 coefficients[o][1], coefficients[o][0], coefficients[o][1], coefficients[o][0]);
+		blue_zero[o] = _mm_set_epi16(0, coefficients[o][2], 0, coefficients[o][2], 0, coefficients[o][2], 0, coefficients[o][2]);
+	}
+	int i = 0;
+	for(; i + 16 <= count; i += 16)
+	{
+		__m128i r = _mm_loadu_si128((const __m128i *)(red + i));
+		__m128i g = _mm_loadu_si128((const __m128i *)(green + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(blue + i));
+		// (red, green) and (blue, 0) pairs of pixels 4q to 4q+3
+		__m128i rg[4], bz[4];
+		__m128i r16 = _mm_unpacklo_epi8(r, zero), g16 = _mm_unpacklo_epi8(g, zero), b16 = _mm_unpacklo_epi8(b, zero);
+		rg[0] = _mm_unpacklo_epi16(r16, g16);
+		rg[1] = _mm_unpackhi_epi16(r16, g16);
+		bz[0] = _mm_unpacklo_epi16(b16, zero);
+		bz[1] = _mm_unpackhi_epi16(b16, zero);
+		r16 = _mm_unpackhi_epi8(r, zero);
+		g16 = _mm_unpackhi_epi8(g, zero);
+		b16 = _mm_unpackhi_epi8(b, zero);
+		rg[2] = _mm_unpacklo_epi16(r16, g16);
+		rg[3] = _mm_unpackhi_epi16(r16, g16);
+		bz[2] = _mm_unpacklo_epi16(b16, zero);
+		bz[3] = _mm_unpackhi_epi16(b16, zero);
+		for(int o = 0; o < 3; o++)
+		{
+			__m128i result[4];
+			for(int q = 0; q < 4; q++)
+			{
+				__m128i sum = _mm_add_epi32(_mm_madd_epi16(rg[q], red_green[o]), _mm_madd_epi16(bz[q], blue_zero[o]));
+				result[q] = _mm_srli_epi32(sum, FIXED_SHIFT);
+			}
+			__m128i packed = _mm_packus_epi16(_mm_packs_epi32(result[0], result[1]), _mm_packs_epi32(result[2], result[3]));
+			_mm_storeu_si128((__m128i *)(outputs[o] + i), packed);
+		}
+	}
+	for(; i < count; i++)
+	{
+		for(int o = 0; o < 3; o++)
+		{
+			int sum = (coefficients[o][0]*red[i] + coefficients[o][1]*green[i] + coefficients[o][2]*blue[i]) >> FIXED_SHIFT;
+			outputs[o][i] = (unsigned char)(sum > 255 ? 255 : sum);
+		}
+	}
+}
+
+// Description:
+// Fixed-point sepia tone of packed pixels. Each cilk_for iteration takes FIXED_CHUNK pixels, which it
+// splits into planes on the stack FIXED_BLOCK pixels at a time, filters, and packs into outdataset.
+//
+// [in]: indataset, size_of_image
+// [out]: outdataset
+#if defined(_WIN32)
+__declspec(noinline) 
+#else
+__attribute__ ((noinline))
+#endif
+void process_image_fixed_cilk_for(rgb *indataset, rgb *outdataset, int size_of_image){
+	int chunks = (size_of_image + FIXED_CHUNK - 1)/FIXED_CHUNK;
+	cilk_for(int k = 0; k < chunks; k++)
+	{
+		int end = ((k + 1)*FIXED_CHUNK < size_of_image) ? (k + 1)*FIXED_CHUNK : size_of_image;
+		unsigned char in_planes[3][FIXED_BLOCK], out_planes[3][FIXED_BLOCK];
+		for(int first = k*FIXED_CHUNK; first < end; first += FIXED_BLOCK)
+		{
+			int count = (first + FIXED_BLOCK < end) ? FIXED_BLOCK : end - first;
+			planar::deinterleave((unsigned char *)(indataset + first), in_planes[0], in_planes[1], in_planes[2], count);
+			process_planes_fixed(in_planes[0], in_planes[1], in_planes[2], out_planes[0], out_planes[1], out_planes[2], count);
+			planar::interleave(out_planes[0], out_planes[1], out_planes[2], (unsigned char *)(outdataset + first), count);
+		}
+	}
+}
+
+// Allocates three planes of size pixels
+static bool allocate_planes(SOA_rgb &planes, int size){
+#if defined(_WIN32)
+	planes.blue = (unsigned char *)_aligned_malloc(size, ALIGNMENT);
+	planes.green = (unsigned char *)_aligned_malloc(size, ALIGNMENT);
+	planes.red = (unsigned char *)_aligned_malloc(size, ALIGNMENT);
+#else
+	planes.blue = (unsigned char *)_mm_malloc(size, ALIGNMENT);
+	planes.green = (unsigned char *)_mm_malloc(size, ALIGNMENT);
+	planes.red = (unsigned char *)_mm_malloc(size, ALIGNMENT);
+#endif
+	return planes.blue != NULL && planes.green != NULL && planes.red != NULL;
+}
+
+static void free_planes(SOA_rgb &planes){
+#if defined(_WIN32)
+	_aligned_free(planes.blue);
+	_aligned_free(planes.green);
+	_aligned_free(planes.red);
+#else
+	_mm_free(planes.blue);
+	_mm_free(planes.green);
+	_mm_free(planes.red);
+#endif
+}
+
+
+// Entries per axis of the 3D table of version 7
+#define SEPIA_LUT3D_SIZE 33
+
 //This API does the reading and writing from/to the .bmp file. Also invokes the image processing API from here
 #if defined(_WIN32)
 __declspec(noinline) 
@@ -55,9 +276,8 @@ __attribute__ ((noinline))
 #endif
 int read_process_write(char* input, char *output, int choice) {
 
-    FILE *fp,*out;
-    bitmap_header* hp;
-    int n;
+    bmpio::MappedBMP in;
+    const bitmap_header* hp;
 	CUtilTimer timer;
 	float *temp;
     // Making sure the AOS alignes to an address which is multiple of 16 to support vectorization 
@@ -67,28 +287,17 @@ int read_process_write(char* input, char *output, int choice) {
 	__attribute__((aligned(ALIGNMENT))) rgb *indata, *outdata;
 #endif
 
-    //Instantiating a file handle to open a input BMP file in binary mode
-    fp = fopen(input, "rb");
-    if(fp==NULL){
+    //Mapping the input BMP file into memory. The header and the pixels are read in place from the mapping
+    if(!in.open(input)){
         cout<<"The file could not be opened. Program will be exiting\n";
 	return 0;
     }
-
-
-    //Allocating memory for storing the bitmap header information which will be retrived from input image file
-    hp=(bitmap_header*)malloc(sizeof(bitmap_header));
-    if(hp==NULL)
-    {
-	cout<<"Unable to allocate the memory for bitmap header\n";
+    //The output is written while the input is still mapped, so they must be different files
+    if(bmpio::same_file(input, output)){
+        cout<<"The output file must not be the input file. Program will be exiting\n";
         return 0;
     }
-
-    //Reading from input file the bitmap header information which is inturn stored in memory allocated in the previous step
-    n=fread(hp, sizeof(bitmap_header), 1, fp);
-        if(n<1){
-            cout<<"Read error from the file. No bytes were read from the file. Program exiting \n";
-            return 0;        
-        }
+    hp=(const bitmap_header*)in.header();
 
     if(hp->bitsperpixel != 24){
         cout<<"This is not a RGB image\n";
@@ -108,15 +317,8 @@ int read_process_write(char* input, char *output, int choice) {
         return 0;
     }
 
-    // Setting the File descriptor to the starting point in the input file where the bitmap data(payload) starts
-    fseek(fp,sizeof(char)*hp->fileheader.dataoffset,SEEK_SET);
-
-    // Reading the bitmap data from the input bmp file to the memory allocated in the previous step
-    n=fread(indata, sizeof(rgb), (size_of_image), fp);
-    if(n<1){
-        cout<<"Read error from the file. No bytes were read from the file. Program exiting \n";
-        return 0;
-    }
+    // Copying the bitmap data from the mapping to the aligned buffer, without the padding at the end of the rows
+    in.copy_pixels((unsigned char *)indata);
 	
 	//Allocate memory for storing the bitmap data of the processed image
 #if defined(_WIN32)
@@ -128,50 +330,79 @@ int read_process_write(char* input, char *output, int choice) {
         cout<<"Unable to allocate the memory for bitmap date\n";
         return 0;
     }
+    //Versions 3 and 4 work on planes: the input is split into in_planes and the result packed from out_planes
+    SOA_rgb in_planes = {0, 0, 0}, out_planes = {0, 0, 0};
+    if(choice == 3 || choice == 4){
+        if(!allocate_planes(in_planes, size_of_image) || !allocate_planes(out_planes, size_of_image)){
+            cout<<"Unable to allocate the memory for the image planes\n";
+            return 0;
+        }
+    }
+    //Versions 6 and 7 use the color transform engine with the sepia preset, 7 baked into a 3D table
+    ColorTransform transform = ColorTransform::sepia();
+    if(choice == 7)
+        transform.bake_lut3d(SEPIA_LUT3D_SIZE);
     // Involing the image processing API which does some manipulation on the bitmap data read from the input .bmp file
 		long long avg_time;
 		avg_time = 0;
 		for(int k=0; k<5; ++k) {
 
+		switch(choice){
+		// Packed (AOS) version
+		case 2:
     timer.start();
 				cilk_for(int i = 0; i < size_of_image; i++)
 				{
 					process_image_AOS(indata[i], outdata[i]);
 				}
 				timer.stop();
+				break;
+		// Planar (SOA) SIMD version, timed with the conversions from and to packed pixels
+		case 3:
+				timer.start();
+				planar::deinterleave_cilk_for((unsigned char *)indata, in_planes.blue, in_planes.green, in_planes.red, size_of_image);
+				process_image_SOA_cilk_for(in_planes, out_planes, size_of_image);
+				planar::interleave_cilk_for(out_planes.blue, out_planes.green, out_planes.red, (unsigned char *)outdata, size_of_image);
+				timer.stop();
+				break;
+		// Planar (SOA) SIMD version, timing the filter only
+		case 4:
+				planar::deinterleave_cilk_for((unsigned char *)indata, in_planes.blue, in_planes.green, in_planes.red, size_of_image);
+				timer.start();
+				process_image_SOA_cilk_for(in_planes, out_planes, size_of_image);
+				timer.stop();
+				planar::interleave_cilk_for(out_planes.blue, out_planes.green, out_planes.red, (unsigned char *)outdata, size_of_image);
+				break;
+		// Fixed-point SIMD version on packed pixels
+		case 5:
+				timer.start();
+				process_image_fixed_cilk_for(indata, outdata, size_of_image);
+				timer.stop();
+				break;
+		// Color transform engine, sepia matrix or 3D table
+		case 6:
+		case 7:
+				timer.start();
+				transform.apply_cilk_for((unsigned char *)indata, (unsigned char *)outdata, size_of_image);
+				timer.stop();
+				break;
+		default: cout<<"Wrong choice\n";
+				return 0;
+		}
 
 		avg_time += timer.get_ticks();
 		}
 		avg_time /= 5;
 
-	// Opening an output file to which the processed result will be written
-    out = fopen(output, "wb");
-    if(out==NULL){
-        cout<<"The file could not be opened. Program will be exiting\n";
-        return 0;
-    }
-
-    // Writing the bitmap header which we copied from the input file to the output file. We need not make any changes because we haven't made any change to the image size or compression type.
-    n=fwrite(hp,sizeof(char),sizeof(bitmap_header),out);
-    if(n<1){
-        cout<<"Write error to the file. No bytes were wrtten to the file. Program exiting \n";
-        return 0;
-    }
-
-    //Setting the file descriptor to point to the location where the bitmap data is to be written 
-    fseek(out,sizeof(char)*hp->fileheader.dataoffset,SEEK_SET);
-
-    // Writing the bitmap data of the processed image to the output file
-    n=fwrite(outdata,sizeof(rgb),(size_of_image),out);
-    if(n<1){
+    // Writing the header copied from the input file and the bitmap data of the processed image to the output file.
+    // We need not make any changes to the header because we haven't made any change to the image size or compression type.
+    if(!bmpio::write_bmp(output, in.header(), in.data_offset(), (unsigned char *)outdata, hp->width, hp->height, 24)){
         cout<<"Write error to the file. No bytes were wrtten to the file. Program exiting \n";
         return 0;
     }
 	cout<<avg_time<<"\n";
-    // Closing all file handles and also freeing all the dynamically allocated memory
-    fclose(fp);
-    fclose(out);
-    free(hp);
+    // Unmapping the input file and also freeing all the dynamically allocated memory
+    in.close();
 #if defined(_WIN32)
     _aligned_free(indata);
     _aligned_free(outdata);
@@ -179,10 +410,27 @@ int read_process_write(char* input, char *output, int choice) {
 	_mm_free(indata);
 	_mm_free(outdata);
 #endif
+    free_planes(in_planes);
+    free_planes(out_planes);
     return 0;
 }
+//Filter used by the batch mode, the same loop as in read_process_write
+void batch_filter(unsigned char *in, unsigned char *out, int w, int h){
+	rgb *indata = (rgb *)in, *outdata = (rgb *)out;
+	cilk_for(int i = 0; i < w * h; i++)
+	{
+		process_image_AOS(indata[i], outdata[i]);
+	}
+}
+
 int main(int argc, char *argv[]){
+		if(argc > 1 && strcmp(argv[1], "-batch") == 0)
+			return batch::batch_main(argc, argv, batch_filter);
+		// 2: packed pixels, 3: planes with the conversions timed, 4: planes without the conversions,
+		// 5: fixed-point on packed pixels, 6: color transform engine, 7: color transform baked into a 3D table
 		int choice = 2;
+		if(argc > 3)
+			choice = atoi(argv[3]);
         read_process_write(argv[1], argv[2], choice);
         return 0;
 }
@@ -10,6 +10,8 @@
 // PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
 //
 // ======================================================================================
+#ifndef SEPIA_FILTER_CILK_PLUS_H
+#define SEPIA_FILTER_CILK_PLUS_H
  
 
 
@@ -54,4 +56,5 @@ typedef struct {
 } SOA_rgb;
 
 #pragma pack(pop)
- 
\ No newline at end of file
+
+#endif // SEPIA_FILTER_CILK_PLUS_H
@@ -0,0 +1,235 @@
+//==============================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ===============================================================
+
+#include "batch_pipeline.h"
+#include "bmp_io.h"
+#include "timer.h"
+
+#include <iostream>
+#include <algorithm>
+#include <string.h>
+#include <cilk/cilk.h>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#else
+#include <mm_malloc.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#define ALIGNMENT 32
+
+using namespace std;
+
+namespace batch {
+
+// One image in flight. The input stays mapped from decode to encode, which copies its header
+struct Slot {
+	bmpio::MappedBMP file;
+	unsigned char* in;
+	unsigned char* out;
+	size_t capacity;
+	bool good;
+};
+
+LatencyHistogram::LatencyHistogram() : m_total_count(0), m_total(0.0), m_max(0.0) {
+	memset(m_counts, 0, sizeof(m_counts));
+}
+
+void LatencyHistogram::add(double seconds) {
+	double microseconds = seconds * 1e6;
+	int bucket = 0;
+	while (bucket < HISTOGRAM_BUCKETS - 1 && microseconds >= double(2 << bucket)) {
+		++bucket;
+	}
+	++m_counts[bucket];
+	++m_total_count;
+	m_total += seconds;
+	m_max = max(m_max, seconds);
+}
+
+void LatencyHistogram::print(const char* name) const {
+	cout << name << ": " << m_total_count << " images, mean "
+		 << (m_total_count > 0 ? m_total / m_total_count * 1e6 : 0.0) << " us, max " << m_max * 1e6 << " us\n";
+	for (int k = 0; k < HISTOGRAM_BUCKETS; ++k) {
+		if (m_counts[k] > 0) {
+			cout << "  " << (k == 0 ? 0 : 1 << k) << " - " << (2 << k) << " us: " << m_counts[k] << "\n";
+		}
+	}
+}
+
+vector<string> list_images(char** arguments, int count) {
+	vector<string> images;
+	for (int i = 0; i < count; ++i) {
+		string name = arguments[i];
+#if !defined(_WIN32)
+		struct stat st;
+		if (stat(name.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+			vector<string> files;
+			DIR* dir = opendir(name.c_str());
+			if (dir == NULL) {
+				continue;
+			}
+			while (struct dirent* entry = readdir(dir)) {
+				string file = entry->d_name;
+				if (file.size() > 4 && file.compare(file.size() - 4, 4, ".bmp") == 0) {
+					files.push_back(name + "/" + file);
+				}
+			}
+			closedir(dir);
+			sort(files.begin(), files.end());
+			images.insert(images.end(), files.begin(), files.end());
+			continue;
+		}
+#endif
+		images.push_back(name);
+	}
+	return images;
+}
+
+// Maps the input file and copies its pixels to the input buffer of the slot,
+// which only grows when an image is larger than every previous one
+static void decode(Slot& slot, const string& input, LatencyHistogram& latency) {
+	CUtilTimer timer;
+	timer.start();
+	slot.good = slot.file.open(input.c_str()) && slot.file.bits_per_pixel() == 24;
+	if (slot.good) {
+		size_t size = slot.file.row_bytes() * slot.file.height();
+		if (size > slot.capacity) {
+			_mm_free(slot.in);
+			_mm_free(slot.out);
+			slot.in = (unsigned char*)_mm_malloc(size, ALIGNMENT);
+			slot.out = (unsigned char*)_mm_malloc(size, ALIGNMENT);
+			slot.capacity = size;
+		}
+		slot.file.copy_pixels(slot.in);
+	}
+	timer.stop();
+	latency.add(timer.get_time());
+}
+
+static void filter_image(Slot& slot, filter_function filter, LatencyHistogram& latency) {
+	if (!slot.good) {
+		return;
+	}
+	CUtilTimer timer;
+	timer.start();
+	filter(slot.in, slot.out, slot.file.width(), slot.file.height());
+	timer.stop();
+	latency.add(timer.get_time());
+}
+
+// Writes the output buffer with the header of the input, and releases the input mapping
+static void encode(Slot& slot, const string& output, LatencyHistogram& latency) {
+	if (!slot.good) {
+		return;
+	}
+	CUtilTimer timer;
+	timer.start();
+	slot.good = bmpio::write_bmp(output.c_str(), slot.file.header(), slot.file.data_offset(), slot.out,
+								 slot.file.width(), slot.file.height(), 24);
+	slot.file.close();
+	timer.stop();
+	latency.add(timer.get_time());
+}
+
+static string output_name(const string& input, const string& output_dir) {
+	size_t separator = input.find_last_of("/\\");
+	return output_dir + "/" + (separator == string::npos ? input : input.substr(separator + 1));
+}
+
+static string directory_name(const string& input) {
+	size_t separator = input.find_last_of("/\\");
+	return separator == string::npos ? string(".") : input.substr(0, separator + 1);
+}
+
+bool run_batch(const vector<string>& inputs, const string& output_dir, filter_function filter, BatchStats& stats) {
+	// The directories are compared as files (by inode), so other paths to the same directory are caught too
+	for (size_t i = 0; i < inputs.size(); ++i) {
+		if (bmpio::same_file(directory_name(inputs[i]).c_str(), output_dir.c_str())) {
+			cout << "The output directory must not hold the input " << inputs[i] << "\n";
+			return false;
+		}
+	}
+	Slot slots[BATCH_SLOTS];
+	for (int s = 0; s < BATCH_SLOTS; ++s) {
+		slots[s].in = slots[s].out = 0;
+		slots[s].capacity = 0;
+		slots[s].good = false;
+	}
+	stats.images = 0;
+	stats.failures = 0;
+
+	CUtilTimer timer;
+	timer.start();
+	const int n = (int)inputs.size();
+	// At step k, image k is decoded, image k-1 filtered and image k-2 encoded, all at once
+	for (int step = 0; step < n + BATCH_SLOTS - 1; ++step) {
+		if (step < n) {
+			cilk_spawn decode(slots[step % BATCH_SLOTS], inputs[step], stats.decode);
+		}
+		if (step >= 1 && step - 1 < n) {
+			cilk_spawn filter_image(slots[(step - 1) % BATCH_SLOTS], filter, stats.filter);
+		}
+		if (step >= 2 && step - 2 < n) {
+			encode(slots[(step - 2) % BATCH_SLOTS], output_name(inputs[step - 2], output_dir), stats.encode);
+		}
+		cilk_sync;
+		if (step >= 2 && step - 2 < n) {
+			Slot& done = slots[(step - 2) % BATCH_SLOTS];
+			if (done.good) {
+				++stats.images;
+			}
+			else {
+				cout << "Could not process " << inputs[step - 2] << "\n";
+				done.file.close();
+				++stats.failures;
+			}
+		}
+	}
+	timer.stop();
+	stats.seconds = timer.get_time();
+
+	for (int s = 0; s < BATCH_SLOTS; ++s) {
+		_mm_free(slots[s].in);
+		_mm_free(slots[s].out);
+	}
+	return true;
+}
+
+int batch_main(int argc, char** argv, filter_function filter) {
+	if (argc < 4) {
+		cout << "Program usage is <modified_program> -batch <outputdir> <inputfile.bmp | inputdir> ...\n";
+		return 0;
+	}
+	vector<string> inputs = list_images(argv + 3, argc - 3);
+	if (inputs.empty()) {
+		cout << "No input images\n";
+		return 0;
+	}
+	BatchStats stats;
+	if (!run_batch(inputs, argv[2], filter, stats)) {
+		return 0;
+	}
+
+	stats.decode.print("decode");
+	stats.filter.print("filter");
+	stats.encode.print("encode");
+	cout << stats.images << " images, " << stats.failures << " failures, "
+		 << stats.images / stats.seconds << " images/s\n";
+	cout << stats.seconds << "\n";
+	return 0;
+}
+
+} // namespace batch
@@ -0,0 +1,276 @@
+//==============================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ===============================================================
+
+#include "bmp_io.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <cilk/cilk.h>
+#include <vector>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <mm_malloc.h>
+#endif
+
+namespace bmpio {
+
+// Rows copied by one iteration of the parallel row loops
+const int ROWS_PER_TASK = 16;
+
+// Offsets of the fields read from the file header and the info header
+const size_t OFFSET_DATA = 10;
+const size_t OFFSET_WIDTH = 18;
+const size_t OFFSET_HEIGHT = 22;
+const size_t OFFSET_BPP = 28;
+const size_t OFFSET_COMPRESSION = 30;
+const size_t HEADERS_SIZE = 54;
+
+template <typename T>
+static T field(const unsigned char* data, size_t offset) {
+	T value;
+	memcpy(&value, data + offset, sizeof(T));
+	return value;
+}
+
+// Copies height rows of row_bytes bytes between buffers with different strides,
+// and clears the padding of the destination rows
+static void copy_rows(unsigned char* dst, size_t dst_stride, const unsigned char* src, size_t src_stride,
+					  size_t row_bytes, int height) {
+	const int tasks = (height + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+	cilk_for (int t = 0; t < tasks; ++t) {
+		const int end = (t + 1) * ROWS_PER_TASK < height ? (t + 1) * ROWS_PER_TASK : height;
+		for (int y = t * ROWS_PER_TASK; y < end; ++y) {
+			memcpy(dst + y * dst_stride, src + y * src_stride, row_bytes);
+			if (dst_stride > row_bytes) {
+				memset(dst + y * dst_stride + row_bytes, 0, dst_stride - row_bytes);
+			}
+		}
+	}
+}
+
+MappedBMP::MappedBMP() :
+	m_data(0), m_size(0), m_data_offset(0), m_stride(0), m_width(0), m_height(0), m_bpp(0), m_fd(-1) {
+}
+
+MappedBMP::~MappedBMP() {
+	close();
+}
+
+bool MappedBMP::open(const char* filename) {
+	close();
+#if defined(_WIN32)
+	// No mapping: the whole file is read at once
+	FILE* fp = fopen(filename, "rb");
+	if (fp == NULL) {
+		return false;
+	}
+	fseek(fp, 0, SEEK_END);
+	m_size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	m_data = (unsigned char*)malloc(m_size);
+	if (m_data == NULL || fread(m_data, 1, m_size, fp) != m_size) {
+		fclose(fp);
+		close();
+		return false;
+	}
+	fclose(fp);
+#else
+	m_fd = ::open(filename, O_RDONLY);
+	if (m_fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(m_fd, &st) != 0 || st.st_size < (off_t)HEADERS_SIZE) {
+		close();
+		return false;
+	}
+	m_size = st.st_size;
+	void* data = mmap(0, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+	if (data == MAP_FAILED) {
+		close();
+		return false;
+	}
+	m_data = (unsigned char*)data;
+	// The pixels are read once from the first row to the last
+	madvise(data, m_size, MADV_SEQUENTIAL);
+#endif
+
+	if (m_size < HEADERS_SIZE || m_data[0] != 'B' || m_data[1] != 'M' ||
+		field<unsigned int>(m_data, OFFSET_COMPRESSION) != 0) {
+		close();
+		return false;
+	}
+	m_data_offset = field<unsigned int>(m_data, OFFSET_DATA);
+	m_width = field<int>(m_data, OFFSET_WIDTH);
+	m_height = field<int>(m_data, OFFSET_HEIGHT);
+	m_bpp = field<unsigned short>(m_data, OFFSET_BPP);
+	if (m_width <= 0 || m_height <= 0 || m_bpp % 8 != 0) {
+		close();
+		return false;
+	}
+	m_stride = row_stride(m_width, m_bpp);
+	// The last row does not need its padding
+	if (m_data_offset + (m_height - 1) * m_stride + row_bytes() > m_size) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedBMP::close() {
+#if defined(_WIN32)
+	free(m_data);
+#else
+	if (m_data != 0) {
+		munmap(m_data, m_size);
+	}
+	if (m_fd >= 0) {
+		::close(m_fd);
+	}
+#endif
+	m_data = 0;
+	m_size = 0;
+	m_fd = -1;
+	m_width = m_height = m_bpp = 0;
+}
+
+void MappedBMP::copy_pixels(unsigned char* dst) const {
+	if (packed()) {
+		memcpy(dst, pixels(), row_bytes() * m_height);
+		return;
+	}
+	copy_rows(dst, row_bytes(), pixels(), m_stride, row_bytes(), m_height);
+}
+
+#if defined(_WIN32)
+
+bool same_file(const char* first, const char* second) {
+	char first_path[_MAX_PATH], second_path[_MAX_PATH];
+	return _fullpath(first_path, first, _MAX_PATH) != NULL && _fullpath(second_path, second, _MAX_PATH) != NULL &&
+		_stricmp(first_path, second_path) == 0;
+}
+
+bool write_bmp(const char* filename, const unsigned char* header, size_t data_offset,
+			   const unsigned char* pixels, int width, int height, int bits_per_pixel) {
+	const size_t row_bytes = (size_t(width) * bits_per_pixel) / 8;
+	const size_t stride = row_stride(width, bits_per_pixel);
+	const unsigned char padding[4] = {0, 0, 0, 0};
+	FILE* out = fopen(filename, "wb");
+	if (out == NULL) {
+		return false;
+	}
+	bool good = fwrite(header, 1, data_offset, out) == data_offset;
+	for (int y = 0; good && y < height; ++y) {
+		good = fwrite(pixels + y * row_bytes, 1, row_bytes, out) == row_bytes &&
+			fwrite(padding, 1, stride - row_bytes, out) == stride - row_bytes;
+	}
+	fclose(out);
+	return good;
+}
+
+#else
+
+bool same_file(const char* first, const char* second) {
+	struct stat first_st, second_st;
+	return stat(first, &first_st) == 0 && stat(second, &second_st) == 0 &&
+		first_st.st_dev == second_st.st_dev && first_st.st_ino == second_st.st_ino;
+}
+
+// Writes size bytes at offset, retrying on short writes
+static bool pwrite_all(int fd, const unsigned char* data, size_t size, off_t offset) {
+	while (size > 0) {
+		ssize_t n = pwrite(fd, data, size, offset);
+		if (n <= 0) {
+			return false;
+		}
+		data += n;
+		size -= n;
+		offset += n;
+	}
+	return true;
+}
+
+// Fallback of write_bmp for files which cannot be mapped
+static bool pwrite_bmp(int fd, const unsigned char* header, size_t data_offset,
+					   const unsigned char* pixels, size_t row_bytes, size_t stride, int height) {
+	if (!pwrite_all(fd, header, data_offset, 0)) {
+		return false;
+	}
+	if (stride == row_bytes) {
+		// Packed rows: the pixels are written as they are, one chunk at a time
+		const size_t size = row_bytes * height;
+		for (size_t done = 0; done < size; done += WRITE_CHUNK) {
+			const size_t n = size - done < WRITE_CHUNK ? size - done : WRITE_CHUNK;
+			if (!pwrite_all(fd, pixels + done, n, data_offset + done)) {
+				return false;
+			}
+		}
+		return true;
+	}
+	// Padded rows are gathered into a chunk buffer first
+	const int rows_per_chunk = stride < WRITE_CHUNK ? int(WRITE_CHUNK / stride) : 1;
+	unsigned char* chunk = (unsigned char*)_mm_malloc(rows_per_chunk * stride, 4096);
+	if (chunk == NULL) {
+		return false;
+	}
+	bool good = true;
+	for (int y = 0; good && y < height; y += rows_per_chunk) {
+		const int rows = height - y < rows_per_chunk ? height - y : rows_per_chunk;
+		copy_rows(chunk, stride, pixels + y * row_bytes, row_bytes, row_bytes, rows);
+		good = pwrite_all(fd, chunk, rows * stride, data_offset + y * stride);
+	}
+	_mm_free(chunk);
+	return good;
+}
+
+bool write_bmp(const char* filename, const unsigned char* header, size_t data_offset,
+			   const unsigned char* pixels, int width, int height, int bits_per_pixel) {
+	const size_t row_bytes = (size_t(width) * bits_per_pixel) / 8;
+	const size_t stride = row_stride(width, bits_per_pixel);
+	const size_t size = data_offset + stride * height;
+
+	// The header usually comes from the mapping of the input file, which O_TRUNC would clear
+	// if it is also the output file
+	std::vector<unsigned char> saved(header, header + data_offset);
+	header = &saved[0];
+	int fd = ::open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		return false;
+	}
+	void* data = MAP_FAILED;
+	if (ftruncate(fd, size) == 0) {
+		data = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	bool good;
+	if (data != MAP_FAILED) {
+		unsigned char* file = (unsigned char*)data;
+		memcpy(file, header, data_offset);
+		copy_rows(file + data_offset, stride, pixels, row_bytes, row_bytes, height);
+		good = munmap(data, size) == 0;
+	}
+	else {
+		good = pwrite_bmp(fd, header, data_offset, pixels, row_bytes, stride, height);
+	}
+	return ::close(fd) == 0 && good;
+}
+
+#endif
+
+} // namespace bmpio
@@ -0,0 +1,98 @@
+//==============================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ===============================================================
+
+// BMP file I/O shared by the image samples.
+// Input files are mapped into memory and read in place: the header and every row of pixels
+// are views into the mapping, with rows padded to a multiple of 4 bytes as stored in the file.
+// Output files are written through a writable mapping, or with pwrite of large aligned chunks
+// when the file cannot be mapped.
+// The same files are copied in every sample which reads or writes BMP images, like timer.h.
+
+#ifndef BMP_IO_H
+#define BMP_IO_H
+
+#include <stddef.h>
+
+namespace bmpio {
+
+// Size of the chunks written with pwrite when the output file is not mapped
+const size_t WRITE_CHUNK = 1 << 20;
+
+// Bytes in one stored row of a BMP image: rows are padded to a multiple of 4 bytes
+inline size_t row_stride(int width, int bits_per_pixel) {
+	return ((size_t(width) * bits_per_pixel + 31) / 32) * 4;
+}
+
+// Read only view of a BMP file mapped into memory
+class MappedBMP {
+public:
+	MappedBMP();
+	~MappedBMP();
+	// Maps filename and checks its header. Returns false if the file cannot be opened
+	// or is not an uncompressed bottom-up BMP
+	bool open(const char* filename);
+	void close();
+	bool is_open() const { return m_data != 0; }
+
+	int width() const { return m_width; }
+	int height() const { return m_height; }
+	int bits_per_pixel() const { return m_bpp; }
+	// Everything before the pixels: file header, info header and color table
+	const unsigned char* header() const { return m_data; }
+	size_t data_offset() const { return m_data_offset; }
+	// Bytes between two consecutive rows, padding included
+	size_t stride() const { return m_stride; }
+	// Bytes of pixel data in one row, padding excluded
+	size_t row_bytes() const { return (size_t(m_width) * m_bpp) / 8; }
+	// True if the rows have no padding, so the pixels are one packed array
+	bool packed() const { return m_stride == row_bytes(); }
+	// Row y of the image, in file order (the bottom row first)
+	const unsigned char* row(int y) const { return m_data + m_data_offset + y * m_stride; }
+	const unsigned char* pixels() const { return m_data + m_data_offset; }
+
+	// Copies the pixels, without the row padding, to dst (width * height * bits_per_pixel / 8 bytes).
+	// Rows are copied in parallel
+	void copy_pixels(unsigned char* dst) const;
+
+private:
+	MappedBMP(const MappedBMP&);
+	MappedBMP& operator=(const MappedBMP&);
+
+	unsigned char* m_data;
+	size_t m_size;
+	size_t m_data_offset;
+	size_t m_stride;
+	int m_width, m_height, m_bpp;
+	int m_fd;
+};
+
+// True if first and second name the same existing file or directory, for example through
+// a different relative path or a link
+bool same_file(const char* first, const char* second);
+
+// Description:
+// Writes a BMP file made of the given header bytes followed by the pixels.
+// The pixels are packed rows of width * bits_per_pixel / 8 bytes; the row padding is added here.
+// The file is mapped and filled in parallel, row by row; if mapping fails, it is written with
+// pwrite in WRITE_CHUNK sized pieces.
+// The header is copied before the file is opened, so it may point into a MappedBMP of filename,
+// but the pixels must not: callers reject an output file which is their input (see same_file).
+//
+// [in]: filename, header (data_offset bytes, written as is), pixels, width, height, bits_per_pixel
+// [out]: true on success
+bool write_bmp(const char* filename, const unsigned char* header, size_t data_offset,
+			   const unsigned char* pixels, int width, int height, int bits_per_pixel);
+
+} // namespace bmpio
+
+#endif // BMP_IO_H
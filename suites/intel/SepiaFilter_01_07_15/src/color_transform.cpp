@@ -0,0 +1,258 @@
+//=======================================================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ======================================================================================
+#include<string.h>
+#include<emmintrin.h>
+#if (defined(_WIN32) && defined(__INTEL_COMPILER))
+#include<cilk\cilk.h>
+#elif (defined(__GNUC__) && defined(__INTEL_COMPILER))
+#include<cilk/cilk.h>
+#endif
+#include"color_transform.h"
+#include"planar.h"
+
+ColorTransform::ColorTransform()
+	: m_has_input_luts(false), m_has_matrix(false), m_has_output_luts(false), m_lut3d_size(0){
+	for(int c = 0; c < 3; c++)
+	{
+		for(int v = 0; v < 256; v++)
+			m_input_luts[c][v] = m_output_luts[c][v] = (unsigned char)v;
+		for(int j = 0; j < 4; j++)
+			m_matrix[c][j] = (c == j) ? 1.0f : 0.0f;
+	}
+}
+
+ColorTransform ColorTransform::sepia(){
+	static const float matrix[3][4] = {
+		{0.393f, 0.769f, 0.189f, 0.0f},
+		{0.349f, 0.686f, 0.168f, 0.0f},
+		{0.272f, 0.534f, 0.131f, 0.0f}
+	};
+	ColorTransform transform;
+	transform.set_matrix(matrix);
+	return transform;
+}
+
+void ColorTransform::set_matrix(const float matrix[3][4]){
+	m_has_matrix = false;
+	for(int o = 0; o < 3; o++)
+	{
+		for(int j = 0; j < 4; j++)
+		{
+			m_matrix[o][j] = matrix[o][j];
+			if(matrix[o][j] != ((o == j) ? 1.0f : 0.0f))
+				m_has_matrix = true;
+		}
+	}
+}
+
+// Copies table into luts[channel], and tells whether any of the tables differs from the identity
+static bool set_lut(unsigned char luts[3][256], Channel channel, const unsigned char table[256]){
+	memcpy(luts[channel], table, 256);
+	for(int c = 0; c < 3; c++)
+	{
+		for(int v = 0; v < 256; v++)
+		{
+			if(luts[c][v] != v)
+				return true;
+		}
+	}
+	return false;
+}
+
+void ColorTransform::set_input_lut(Channel channel, const unsigned char table[256]){
+	m_has_input_luts = set_lut(m_input_luts, channel, table);
+}
+
+void ColorTransform::set_output_lut(Channel channel, const unsigned char table[256]){
+	m_has_output_luts = set_lut(m_output_luts, channel, table);
+}
+
+bool ColorTransform::set_lut3d(int size, const unsigned char *table){
+	if(size < LUT3D_MIN_SIZE || size > LUT3D_MAX_SIZE)
+		return false;
+	m_lut3d_size = size;
+	m_lut3d.assign(table, table + 3*size*size*size);
+	// A value v falls between the entries index and index+1 of its axis
+	for(int v = 0; v < 256; v++)
+	{
+		float position = v * (size - 1) / 255.0f;
+		int index = (int)position;
+		if(index > size - 2)
+			index = size - 2;
+		m_lut3d_index[v] = index;
+		m_lut3d_weight[v] = position - index;
+	}
+	return true;
+}
+
+bool ColorTransform::bake_lut3d(int size){
+	if(size < LUT3D_MIN_SIZE || size > LUT3D_MAX_SIZE)
+		return false;
+	std::vector<unsigned char> table(3*size*size*size);
+	unsigned char red[LUT3D_MAX_SIZE], green[LUT3D_MAX_SIZE], blue[LUT3D_MAX_SIZE];
+	unsigned char *planes[3] = { red, green, blue };
+	// One line of entries along blue at a time, at the byte values nearest to the entries
+	for(int r = 0; r < size; r++)
+	{
+		for(int g = 0; g < size; g++)
+		{
+			for(int b = 0; b < size; b++)
+			{
+				red[b] = (unsigned char)((255*r + (size - 1)/2)/(size - 1));
+				green[b] = (unsigned char)((255*g + (size - 1)/2)/(size - 1));
+				blue[b] = (unsigned char)((255*b + (size - 1)/2)/(size - 1));
+			}
+			apply_block(planes, size);
+			unsigned char *entry = &table[3*(r*size + g)*size];
+			for(int b = 0; b < size; b++)
+			{
+				entry[3*b] = red[b];
+				entry[3*b + 1] = green[b];
+				entry[3*b + 2] = blue[b];
+			}
+		}
+	}
+	*this = ColorTransform();
+	return set_lut3d(size, &table[0]);
+}
+
+// Looks every byte of the three planes up in the table of its channel
+static void apply_luts(const unsigned char luts[3][256], unsigned char *planes[3], int count){
+	for(int c = 0; c < 3; c++)
+	{
+		const unsigned char *lut = luts[c];
+		unsigned char *plane = planes[c];
+		for(int i = 0; i < count; i++)
+			plane[i] = lut[plane[i]];
+	}
+}
+
+// Description:
+// Matrix stage on the red, green and blue planes, in place, 16 pixels at a time: the bytes are
+// widened to four vectors of 4 floats per channel, the products and the offset are added in the
+// same order as in process_image_AOS, and the saturating packs clamp the truncated sums to 0..255.
+//
+// [in]: planes, count
+// [out]: planes
+void ColorTransform::apply_matrix(unsigned char *planes[3], int count) const{
+	const __m128i zero = _mm_setzero_si128();
+	__m128 weights[3][4];
+	for(int o = 0; o < 3; o++)
+	{
+		for(int j = 0; j < 4; j++)
+			weights[o][j] = _mm_set1_ps(m_matrix[o][j]);
+	}
+	int i = 0;
+	for(; i + 16 <= count; i += 16)
+	{
+		// Channel c of pixels 4q to 4q+3, as floats
+		__m128 values[3][4];
+		for(int c = 0; c < 3; c++)
+		{
+			__m128i plane = _mm_loadu_si128((const __m128i *)(planes[c] + i));
+			__m128i low = _mm_unpacklo_epi8(plane, zero), high = _mm_unpackhi_epi8(plane, zero);
+			values[c][0] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero));
+			values[c][1] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero));
+			values[c][2] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero));
+			values[c][3] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero));
+		}
+		for(int o = 0; o < 3; o++)
+		{
+			__m128i result[4];
+			for(int q = 0; q < 4; q++)
+			{
+				__m128 temp = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(weights[o][0], values[0][q]),
+															   _mm_mul_ps(weights[o][1], values[1][q])),
+													_mm_mul_ps(weights[o][2], values[2][q])),
+										 weights[o][3]);
+				result[q] = _mm_cvttps_epi32(temp);
+			}
+			__m128i packed = _mm_packus_epi16(_mm_packs_epi32(result[0], result[1]), _mm_packs_epi32(result[2], result[3]));
+			_mm_storeu_si128((__m128i *)(planes[o] + i), packed);
+		}
+	}
+	for(; i < count; i++)
+	{
+		float red = planes[CHANNEL_RED][i], green = planes[CHANNEL_GREEN][i], blue = planes[CHANNEL_BLUE][i];
+		for(int o = 0; o < 3; o++)
+		{
+			float temp = (m_matrix[o][0] * red) + (m_matrix[o][1] * green) + (m_matrix[o][2] * blue) + m_matrix[o][3];
+			planes[o][i] = (unsigned char)(temp > 255 ? 255 : (temp < 0 ? 0 : temp));
+		}
+	}
+}
+
+// Description:
+// 3D table stage on the red, green and blue planes, in place: every pixel is the trilinear
+// interpolation of the 8 entries around it, rounded to the nearest integer.
+//
+// [in]: planes, count
+// [out]: planes
+void ColorTransform::apply_lut3d(unsigned char *planes[3], int count) const{
+	const int size = m_lut3d_size;
+	// Distance between two neighbouring entries along red, green and blue
+	const int red_step = 3*size*size, green_step = 3*size, blue_step = 3;
+	const unsigned char *lut = &m_lut3d[0];
+	for(int i = 0; i < count; i++)
+	{
+		int red = planes[CHANNEL_RED][i], green = planes[CHANNEL_GREEN][i], blue = planes[CHANNEL_BLUE][i];
+		const unsigned char *corner = lut + m_lut3d_index[red]*red_step + m_lut3d_index[green]*green_step
+									  + m_lut3d_index[blue]*blue_step;
+		float wr = m_lut3d_weight[red], wg = m_lut3d_weight[green], wb = m_lut3d_weight[blue];
+		for(int c = 0; c < 3; c++)
+		{
+			const unsigned char *e = corner + c;
+			float c00 = e[0] + wb*(e[blue_step] - e[0]);
+			float c01 = e[green_step] + wb*(e[green_step + blue_step] - e[green_step]);
+			float c10 = e[red_step] + wb*(e[red_step + blue_step] - e[red_step]);
+			float c11 = e[red_step + green_step] + wb*(e[red_step + green_step + blue_step] - e[red_step + green_step]);
+			float c0 = c00 + wg*(c01 - c00);
+			float c1 = c10 + wg*(c11 - c10);
+			planes[c][i] = (unsigned char)(c0 + wr*(c1 - c0) + 0.5f);
+		}
+	}
+}
+
+// Runs every stage which is not the identity on one block of planes
+void ColorTransform::apply_block(unsigned char *planes[3], int count) const{
+	if(m_has_input_luts)
+		apply_luts(m_input_luts, planes, count);
+	if(m_has_matrix)
+		apply_matrix(planes, count);
+	if(m_has_output_luts)
+		apply_luts(m_output_luts, planes, count);
+	if(m_lut3d_size != 0)
+		apply_lut3d(planes, count);
+}
+
+void ColorTransform::apply(const unsigned char *packed_in, unsigned char *packed_out, int pixels) const{
+	unsigned char red[COLOR_BLOCK], green[COLOR_BLOCK], blue[COLOR_BLOCK];
+	unsigned char *planes[3] = { red, green, blue };
+	for(int first = 0; first < pixels; first += COLOR_BLOCK)
+	{
+		int count = (first + COLOR_BLOCK < pixels) ? COLOR_BLOCK : pixels - first;
+		planar::deinterleave(packed_in + 3*first, blue, green, red, count);
+		apply_block(planes, count);
+		planar::interleave(blue, green, red, packed_out + 3*first, count);
+	}
+}
+
+void ColorTransform::apply_cilk_for(const unsigned char *packed_in, unsigned char *packed_out, int pixels) const{
+	int chunks = (pixels + COLOR_CHUNK - 1)/COLOR_CHUNK;
+	cilk_for(int k = 0; k < chunks; k++)
+	{
+		int first = k*COLOR_CHUNK;
+		int count = (first + COLOR_CHUNK < pixels) ? COLOR_CHUNK : pixels - first;
+		apply(packed_in + 3*first, packed_out + 3*first, count);
+	}
+}
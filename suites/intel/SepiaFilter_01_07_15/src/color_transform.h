@@ -0,0 +1,92 @@
+//=======================================================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ======================================================================================
+// Color transform applied to every pixel independently, in four stages:
+//   1. a 256 entry table per channel (input curves),
+//   2. a 3x4 matrix: every output channel is a weighted sum of red, green and blue plus an offset,
+//      computed in float and truncated to 0..255 as in process_image_AOS of the SepiaFilter sample,
+//   3. a 256 entry table per channel (output curves),
+//   4. a 3D table of size^3 colors, interpolated trilinearly between its 8 nearest entries.
+// The stages which are left as the identity are skipped, and the others are done one block of
+// pixels after the other, so several color operations cost a single pass over the image.
+// Sepia tone is the preset ColorTransform::sepia(), which gives the same image as process_image_AOS.
+// Pixels are packed 24 bit pixels, blue, green then red, as in the rgb struct of the samples, so the
+// same files are copied in every sample which uses them, like planar.h.
+#ifndef COLOR_TRANSFORM_H
+#define COLOR_TRANSFORM_H
+
+#include<vector>
+
+// Channel numbers of the tables and of the rows and columns of the matrix
+enum Channel {CHANNEL_RED = 0, CHANNEL_GREEN = 1, CHANNEL_BLUE = 2};
+
+// Pixels transformed by one iteration of the parallel loop
+const int COLOR_CHUNK = 4096;
+
+// Pixels split into planes on the stack at once, small enough to stay in L1
+const int COLOR_BLOCK = 256;
+
+// Sizes allowed for the 3D table
+const int LUT3D_MIN_SIZE = 2;
+const int LUT3D_MAX_SIZE = 65;
+
+class ColorTransform {
+public:
+	// Identity: every stage is skipped
+	ColorTransform();
+
+	// Sepia tone, the same coefficients as process_image_AOS
+	static ColorTransform sepia();
+
+	// matrix[o][0..2] are the weights of red, green and blue in output channel o, matrix[o][3] its offset
+	void set_matrix(const float matrix[3][4]);
+	void set_input_lut(Channel channel, const unsigned char table[256]);
+	void set_output_lut(Channel channel, const unsigned char table[256]);
+
+	// table holds size^3 colors, red, green then blue; entry (r, g, b) starts at 3*((r*size + g)*size + b)
+	// and is the color of (255*r/(size-1), 255*g/(size-1), 255*b/(size-1)). Returns false if size is not
+	// within LUT3D_MIN_SIZE..LUT3D_MAX_SIZE
+	bool set_lut3d(int size, const unsigned char *table);
+
+	// Samples the current transform into a 3D table of the given size, which then replaces every stage.
+	// Whatever the number of stages, the transform then costs one interpolation per pixel, exact at the
+	// entries of the table and interpolated between them
+	bool bake_lut3d(int size);
+
+	// Description:
+	// Transforms pixels packed pixels, one block after the other.
+	//
+	// [in]: packed_in (3 * pixels bytes), pixels
+	// [out]: packed_out (3 * pixels bytes, may be packed_in)
+	void apply(const unsigned char *packed_in, unsigned char *packed_out, int pixels) const;
+
+	// Same as apply, one COLOR_CHUNK of pixels per cilk_for iteration
+	void apply_cilk_for(const unsigned char *packed_in, unsigned char *packed_out, int pixels) const;
+
+private:
+	void apply_block(unsigned char *planes[3], int count) const;
+	void apply_matrix(unsigned char *planes[3], int count) const;
+	void apply_lut3d(unsigned char *planes[3], int count) const;
+
+	bool m_has_input_luts, m_has_matrix, m_has_output_luts;
+	unsigned char m_input_luts[3][256];
+	float m_matrix[3][4];
+	unsigned char m_output_luts[3][256];
+
+	int m_lut3d_size;
+	std::vector<unsigned char> m_lut3d;
+	// Lower entry and weight of the upper entry of the 3D table for every value of a channel
+	int m_lut3d_index[256];
+	float m_lut3d_weight[256];
+};
+
+#endif // COLOR_TRANSFORM_H
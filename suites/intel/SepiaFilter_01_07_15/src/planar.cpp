@@ -0,0 +1,135 @@
+//==============================================================
+//
+// SAMPLE SOURCE CODE - SUBJECT TO THE TERMS OF SAMPLE CODE LICENSE AGREEMENT,
+// http://software.intel.com/en-us/articles/intel-sample-source-code-license-agreement/
+//
+// Copyright 2013 Intel Corporation
+//
+// THIS FILE IS PROVIDED "AS IS" WITH NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE, NON-INFRINGEMENT OF INTELLECTUAL PROPERTY RIGHTS.
+//
+// ===============================================================
+
+#include "planar.h"
+
+#include <cilk/cilk.h>
+// MSVC never defines __SSSE3__, but defines __AVX__ from /arch:AVX on
+#if defined(__SSSE3__) || defined(__AVX__)
+#define PLANAR_SSSE3
+#include <tmmintrin.h>
+#endif
+
+namespace planar {
+
+#if defined(PLANAR_SSSE3)
+
+// Shuffle gathering, from the 16 byte block `block` of 48 packed bytes, the bytes of channel
+// `channel` into their pixel position. Byte 3*i+channel of the packed bytes is pixel i;
+// positions filled from the other blocks are set to 0 (index 0x80)
+static __m128i gather_mask(int channel, int block) {
+	char mask[16];
+	for (int i = 0; i < 16; ++i) {
+		int source = 3 * i + channel;
+		mask[i] = (source / 16 == block) ? char(source % 16) : char(0x80);
+	}
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask));
+}
+
+// Shuffle scattering the 16 pixels of plane `channel` to their bytes in block `block` of the
+// 48 packed bytes; the bytes of the other channels are set to 0
+static __m128i scatter_mask(int channel, int block) {
+	char mask[16];
+	for (int k = 0; k < 16; ++k) {
+		int target = 16 * block + k;
+		mask[k] = (target % 3 == channel) ? char(target / 3) : char(0x80);
+	}
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask));
+}
+
+#endif
+
+void deinterleave(const unsigned char* packed, unsigned char* blue, unsigned char* green,
+				  unsigned char* red, size_t pixels) {
+	size_t i = 0;
+#if defined(PLANAR_SSSE3)
+	__m128i masks[3][3];
+	for (int c = 0; c < 3; ++c) {
+		for (int b = 0; b < 3; ++b) {
+			masks[c][b] = gather_mask(c, b);
+		}
+	}
+	unsigned char* planes[3] = { blue, green, red };
+	for (; i + 16 <= pixels; i += 16) {
+		const __m128i* source = reinterpret_cast<const __m128i*>(packed + 3 * i);
+		__m128i block0 = _mm_loadu_si128(source);
+		__m128i block1 = _mm_loadu_si128(source + 1);
+		__m128i block2 = _mm_loadu_si128(source + 2);
+		for (int c = 0; c < 3; ++c) {
+			__m128i plane = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(block0, masks[c][0]),
+													  _mm_shuffle_epi8(block1, masks[c][1])),
+										 _mm_shuffle_epi8(block2, masks[c][2]));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(planes[c] + i), plane);
+		}
+	}
+#endif
+	for (; i < pixels; ++i) {
+		blue[i] = packed[3 * i];
+		green[i] = packed[3 * i + 1];
+		red[i] = packed[3 * i + 2];
+	}
+}
+
+void interleave(const unsigned char* blue, const unsigned char* green, const unsigned char* red,
+				unsigned char* packed, size_t pixels) {
+	size_t i = 0;
+#if defined(PLANAR_SSSE3)
+	__m128i masks[3][3];
+	for (int c = 0; c < 3; ++c) {
+		for (int b = 0; b < 3; ++b) {
+			masks[c][b] = scatter_mask(c, b);
+		}
+	}
+	for (; i + 16 <= pixels; i += 16) {
+		__m128i planes[3] = {
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(blue + i)),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(green + i)),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(red + i))
+		};
+		__m128i* target = reinterpret_cast<__m128i*>(packed + 3 * i);
+		for (int b = 0; b < 3; ++b) {
+			__m128i block = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(planes[0], masks[0][b]),
+													  _mm_shuffle_epi8(planes[1], masks[1][b])),
+										 _mm_shuffle_epi8(planes[2], masks[2][b]));
+			_mm_storeu_si128(target + b, block);
+		}
+	}
+#endif
+	for (; i < pixels; ++i) {
+		packed[3 * i] = blue[i];
+		packed[3 * i + 1] = green[i];
+		packed[3 * i + 2] = red[i];
+	}
+}
+
+void deinterleave_cilk_for(const unsigned char* packed, unsigned char* blue, unsigned char* green,
+						   unsigned char* red, size_t pixels) {
+	const int chunks = int((pixels + CONVERSION_CHUNK - 1) / CONVERSION_CHUNK);
+	cilk_for (int k = 0; k < chunks; ++k) {
+		size_t first = k * CONVERSION_CHUNK;
+		size_t count = (first + CONVERSION_CHUNK < pixels) ? CONVERSION_CHUNK : pixels - first;
+		deinterleave(packed + 3 * first, blue + first, green + first, red + first, count);
+	}
+}
+
+void interleave_cilk_for(const unsigned char* blue, const unsigned char* green, const unsigned char* red,
+						 unsigned char* packed, size_t pixels) {
+	const int chunks = int((pixels + CONVERSION_CHUNK - 1) / CONVERSION_CHUNK);
+	cilk_for (int k = 0; k < chunks; ++k) {
+		size_t first = k * CONVERSION_CHUNK;
+		size_t count = (first + CONVERSION_CHUNK < pixels) ? CONVERSION_CHUNK : pixels - first;
+		interleave(blue + first, green + first, red + first, packed + 3 * first, count);
+	}
+}
+
+} // namespace planar